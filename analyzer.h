@@ -0,0 +1,447 @@
+#ifndef WARGAME_ANALYZER_H
+#define WARGAME_ANALYZER_H
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "deck.h"
+#include "random.h"
+#include "simulation.h"
+
+/*POSITION ANALYZER
+Works out how a game goes on from a position (the cards in p1_deck, p1_discard, p2_deck and p2_discard) when both seats play given policies: the chance that each player wins and the expected number of battles left.
+A position only records which cards are in each pile. The order of a deck is unknown (to the players as well), and every order is equally likely because each deck is the rest of a uniform shuffle; the order of a discard pile never matters because it is shuffled before it is drawn from.
+
+Exact search: every possible draw of both hands (and all 24 orders for a policy that picks at random: randomOrder, and the policies that fall back on it as P1, who chooses before P2's hand is shown; the others are deterministic) is followed, battle by battle, up to a horizon, giving exact probabilities of a win within that many battles.
+Different draws often lead to the same piles, so evaluated positions are kept in a fixed-size hash table (PositionCache) and each is evaluated once per horizon.
+Exact search is only practical when both players draw from small piles; it gives up when a position has too many draws or too many positions are expanded, and analyzePosition() then samples games instead.
+Battle numbers: a position does not record how many battles were played before it, so the policies are shown battles counted from the analyzed position (battleNum 1 is its first battle), by the exact search and in sampled games alike; the real battle number of the game is not known here (no policy in POLICIES reads it).
+*/
+
+const int ANALYZER_MAX_BATTLES = 10000; //sampled games are abandoned after this many battles, as in tournaments
+
+//Which cards are in each pile: bit c is set if card c is there
+struct Position {
+  uint64_t p1Deck, p1Discard, p2Deck, p2Discard;
+
+  bool operator==(const Position &other) const {
+    return p1Deck == other.p1Deck && p1Discard == other.p1Discard && p2Deck == other.p2Deck && p2Discard == other.p2Discard;
+  }
+  int p1Cards() const { return __builtin_popcountll(p1Deck | p1Discard); }
+  int p2Cards() const { return __builtin_popcountll(p2Deck | p2Discard); }
+};
+
+/*isValidPosition
+Purpose: checking that every one of the 52 cards is in exactly one pile
+*/
+inline bool isValidPosition(const Position &position) {
+  uint64_t piles[4] = {position.p1Deck, position.p1Discard, position.p2Deck, position.p2Discard};
+  uint64_t seen = 0;
+  for (uint64_t pile : piles) {
+    if (seen & pile) {
+      return false;
+    }
+    seen |= pile;
+  }
+  return seen == (1ULL << NUM_CARDS) - 1;
+}
+
+/*pileBits
+Purpose: the set of cards in a pile
+*/
+inline uint64_t pileBits(const CardPile &pile) {
+  uint64_t bits = 0;
+  for (int i=0; i<pile.size(); i++) {
+    bits |= 1ULL << pile[i];
+  }
+  return bits;
+}
+
+/*positionFromPiles
+Purpose: the position of a game in progress (e.g. the piles of the interactive game)
+*/
+inline Position positionFromPiles(const CardPile &p1_deck, const CardPile &p1_discard, const CardPile &p2_deck, const CardPile &p2_discard) {
+  return {pileBits(p1_deck), pileBits(p1_discard), pileBits(p2_deck), pileBits(p2_discard)};
+}
+
+//Canonical 128-bit form of a position: 2 bits per card (0 = P1 deck, 1 = P1 discard, 2 = P2 deck, 3 = P2 discard), cards 0-31 in low, cards 32-51 in the low 40 bits of high, and the search horizon in the rest of high
+struct PositionKey {
+  uint64_t low, high;
+
+  bool operator==(const PositionKey &other) const { return low == other.low && high == other.high; }
+  int horizon() const { return high >> 40; }
+};
+
+/*spreadBits
+Purpose: moving bit i of a 32-bit value to bit 2i
+*/
+inline uint64_t spreadBits(uint64_t x) {
+  x &= 0xFFFFFFFFULL;
+  x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+  x = (x | (x << 8)) & 0x00FF00FF00FF00FFULL;
+  x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  x = (x | (x << 2)) & 0x3333333333333333ULL;
+  x = (x | (x << 1)) & 0x5555555555555555ULL;
+  return x;
+}
+
+/*positionKey
+Purpose: encoding a valid position and a horizon as a PositionKey
+*/
+inline PositionKey positionKey(const Position &position, int horizon) {
+  uint64_t discards = position.p1Discard | position.p2Discard; //low bit of each card's pile number
+  uint64_t p2Cards = position.p2Deck | position.p2Discard; //high bit
+  PositionKey key;
+  key.low = spreadBits(discards) | (spreadBits(p2Cards) << 1);
+  key.high = spreadBits(discards >> 32) | (spreadBits(p2Cards >> 32) << 1) | ((uint64_t)horizon << 40);
+  return key;
+}
+
+struct PositionHash {
+  size_t operator()(const Position &position) const {
+    PositionKey key = positionKey(position, 0);
+    return splitMix64(key.low ^ splitMix64(key.high));
+  }
+};
+
+//How a position goes on within a number of battles
+struct Outcome {
+  double p1Win, p2Win; //probability that P1 (P2) wins within the horizon
+  double battles; //expected number of battles played, counting at most the horizon
+};
+
+/*PositionCache
+Purpose: remembering evaluated positions in a fixed amount of memory
+A hash table of 4-entry buckets; when a bucket is full, the entry with the smallest horizon (the cheapest to evaluate again) is replaced.
+*/
+class PositionCache {
+public:
+  static const int WAYS = 4;
+
+  explicit PositionCache(size_t maxBytes) : hits(0), misses(0), evictions(0) {
+    size_t buckets = 1;
+    while (buckets * 2 * WAYS * sizeof(Entry) <= maxBytes) {
+      buckets *= 2;
+    }
+    entries.assign(buckets * WAYS, Entry());
+    bucketMask = buckets - 1;
+  }
+
+  bool find(const PositionKey &key, Outcome &outcome) {
+    Entry *bucket = bucketFor(key);
+    for (int i=0; i<WAYS; i++) {
+      if (bucket[i].key == key) {
+        outcome = bucket[i].outcome;
+        hits++;
+        return true;
+      }
+    }
+    misses++;
+    return false;
+  }
+
+  void store(const PositionKey &key, const Outcome &outcome) {
+    Entry *bucket = bucketFor(key);
+    Entry *victim = &bucket[0];
+    for (int i=0; i<WAYS; i++) {
+      if (bucket[i].key.high == 0) { //empty (a stored key always has a horizon of at least 1)
+        victim = &bucket[i];
+        break;
+      }
+      if (bucket[i].key.horizon() < victim->key.horizon()) {
+        victim = &bucket[i];
+      }
+    }
+    if (victim->key.high != 0) {
+      evictions++;
+    }
+    victim->key = key;
+    victim->outcome = outcome;
+  }
+
+  size_t bytes() const { return entries.size() * sizeof(Entry); }
+
+  long long hits, misses, evictions;
+
+private:
+  struct Entry {
+    PositionKey key = {0, 0};
+    Outcome outcome = {0, 0, 0};
+  };
+
+  Entry *bucketFor(const PositionKey &key) {
+    return &entries[(splitMix64(key.low ^ splitMix64(key.high)) & bucketMask) * WAYS];
+  }
+
+  std::vector<Entry> entries;
+  size_t bucketMask;
+};
+
+struct AnalysisOptions {
+  int horizon = 30; //battles followed by the exact search
+  size_t cacheBytes = 64 << 20; //memory for the exact search's PositionCache
+  long long maxBranches = 2000000; //the exact search gives up on a position with more combinations of hands and orders than this
+  long long maxExpansions = 200000; //... or after expanding this many positions
+  long long samples = 20000; //games sampled when the exact search gives up
+  uint64_t seed = 1; //sampled game i is played on stream i of this seed
+};
+
+struct AnalysisResult {
+  bool exact; //true: exact probabilities within options.horizon battles; false: estimated from sampled games
+  double p1Win, p2Win;
+  double unfinished; //probability that the game lasts beyond the horizon (exact) or ANALYZER_MAX_BATTLES (sampled)
+  double battles; //expected battles left (exact: counting at most the horizon)
+  double p1WinError, battlesError; //half-width of the 95% confidence interval (sampled only)
+  long long expansions, samples;
+  long long cacheHits, cacheMisses, cacheEvictions;
+  size_t cacheBytes;
+};
+
+/*ExactSearch
+Purpose: evaluating positions exactly, battle by battle, with every evaluated position remembered in a PositionCache
+*/
+class ExactSearch {
+public:
+  ExactSearch(OrderPolicy p1Policy, OrderPolicy p2Policy, const AnalysisOptions &analysisOptions) : cache(analysisOptions.cacheBytes), expansions(0), p1_policy(p1Policy), p2_policy(p2Policy), options(analysisOptions) {
+    p1_orders = playsAtRandom(p1_policy, true) ? 24 : 1;
+    p2_orders = playsAtRandom(p2_policy, false) ? 24 : 1;
+  }
+
+  /*evaluate
+  Purpose: working out how a position goes on, both players having at least 4 cards
+  Parameters: the position, number of battles to follow, outcome that receives the result
+  Return: false if the search gave up (too many draws or positions)
+  */
+  bool evaluate(const Position &position, int horizon, Outcome &outcome) {
+    if (horizon == 0) {
+      outcome = {0, 0, 0};
+      return true;
+    }
+    PositionKey key = positionKey(position, horizon);
+    if (cache.find(key, outcome)) {
+      return true;
+    }
+    if (++expansions > options.maxExpansions) {
+      return false;
+    }
+    //Shuffle in the discard pile of a player with fewer than 4 cards in their deck; the hand is then any 4 cards of the deck, in any order
+    uint64_t p1_pool = position.p1Deck, p1_discard = position.p1Discard;
+    uint64_t p2_pool = position.p2Deck, p2_discard = position.p2Discard;
+    if (__builtin_popcountll(p1_pool) < SIM_HAND_SIZE) {
+      p1_pool |= p1_discard;
+      p1_discard = 0;
+    }
+    if (__builtin_popcountll(p2_pool) < SIM_HAND_SIZE) {
+      p2_pool |= p2_discard;
+      p2_discard = 0;
+    }
+    Card p1_cards[NUM_CARDS], p2_cards[NUM_CARDS];
+    int p1_count = cardsOf(p1_pool, p1_cards), p2_count = cardsOf(p2_pool, p2_cards);
+    double branches = orderedDraws(p1_count) * orderedDraws(p2_count) * p1_orders * p2_orders;
+    if (branches > options.maxBranches) {
+      return false;
+    }
+    double probability = 1.0 / branches;
+
+    //Every draw and order, collected by the piles they lead to
+    std::unordered_map<Position, double, PositionHash> successors;
+    Card hands[2][SIM_HAND_SIZE];
+    int battleNum = options.horizon - horizon + 1; //counted from the analyzed position, as continueGame counts them in sampled games (see the note at the top)
+    forEachDraw(p1_cards, p1_count, hands[0], [&] {
+      forEachDraw(p2_cards, p2_count, hands[1], [&] {
+        BattleView p1_view = {hands[0], nullptr, p1_count - SIM_HAND_SIZE, __builtin_popcountll(p1_discard), p2_count - SIM_HAND_SIZE, __builtin_popcountll(p2_discard), battleNum};
+        BattleView p2_view = {hands[1], hands[0], p2_count - SIM_HAND_SIZE, __builtin_popcountll(p2_discard), p1_count - SIM_HAND_SIZE, __builtin_popcountll(p1_discard), battleNum};
+        unsigned char p1_order[SIM_HAND_SIZE], p2_order[SIM_HAND_SIZE];
+        uint64_t p1_hand = handBits(hands[0]), p2_hand = handBits(hands[1]);
+        for (int o1=0; o1<p1_orders; o1++) {
+          if (p1_orders > 1) {
+            std::memcpy(p1_order, ORDER_PERMUTATIONS[o1], SIM_HAND_SIZE);
+          }
+          else {
+            p1_policy(p1_view, p1_order, unusedRng);
+          }
+          for (int o2=0; o2<p2_orders; o2++) {
+            if (p2_orders > 1) {
+              std::memcpy(p2_order, ORDER_PERMUTATIONS[o2], SIM_HAND_SIZE);
+            }
+            else {
+              p2_policy(p2_view, p2_order, unusedRng);
+            }
+            uint64_t p1_won = 0; //cards going to P1's discard pile; the rest of both hands go to P2's
+            for (int i=0; i<SIM_HAND_SIZE; i++) {
+              Card p1_card = hands[0][p1_order[i]];
+              Card p2_card = hands[1][p2_order[i]];
+              if (p1_card > p2_card) {
+                p1_won |= (1ULL << p1_card) | (1ULL << p2_card);
+              }
+            }
+            Position next = {p1_pool & ~p1_hand, p1_discard | p1_won, p2_pool & ~p2_hand, p2_discard | ((p1_hand | p2_hand) & ~p1_won)};
+            successors[next] += probability;
+          }
+        }
+      });
+    });
+
+    //Apply the loss rule from main() (P1 is checked first) and evaluate the positions that go on
+    Outcome result = {0, 0, 1};
+    for (const auto &successor : successors) {
+      const Position &next = successor.first;
+      double chance = successor.second;
+      if (next.p1Cards() < SIM_HAND_SIZE) {
+        result.p2Win += chance;
+      }
+      else if (next.p2Cards() < SIM_HAND_SIZE) {
+        result.p1Win += chance;
+      }
+      else {
+        Outcome later;
+        if (!evaluate(next, horizon - 1, later)) {
+          return false;
+        }
+        result.p1Win += chance * later.p1Win;
+        result.p2Win += chance * later.p2Win;
+        result.battles += chance * later.battles;
+      }
+    }
+    cache.store(key, result);
+    outcome = result;
+    return true;
+  }
+
+  PositionCache cache;
+  long long expansions;
+
+private:
+  static int cardsOf(uint64_t bits, Card cards[NUM_CARDS]) {
+    int count = 0;
+    for (; bits != 0; bits &= bits - 1) {
+      cards[count++] = __builtin_ctzll(bits);
+    }
+    return count;
+  }
+
+  static uint64_t handBits(const Card hand[SIM_HAND_SIZE]) {
+    return (1ULL << hand[0]) | (1ULL << hand[1]) | (1ULL << hand[2]) | (1ULL << hand[3]);
+  }
+
+  /*playsAtRandom
+  Purpose: finding out whether a policy picks its order at random in a seat, by checking whether it draws from the generator for a sample hand (a policy is assumed to draw for every hand or for none)
+  Parameters: the policy, whether it chooses as P1 (without P2's hand)
+  */
+  static bool playsAtRandom(OrderPolicy policy, bool firstSeat) {
+    const Card hand[SIM_HAND_SIZE] = {0, 13, 26, 39}, otherHand[SIM_HAND_SIZE] = {4, 17, 30, 43};
+    BattleView view = {hand, firstSeat ? nullptr : otherHand, 22, 0, 22, 0, 1};
+    Rng probe, untouched;
+    unsigned char order[SIM_HAND_SIZE];
+    policy(view, order, probe);
+    return !(probe == untouched);
+  }
+
+  static double orderedDraws(int count) {
+    return (double)count * (count-1) * (count-2) * (count-3);
+  }
+
+  //Calls visit() with hand set to every ordered choice of 4 different cards
+  template <typename Visit>
+  static void forEachDraw(const Card cards[], int count, Card hand[SIM_HAND_SIZE], Visit visit) {
+    for (int a=0; a<count; a++) {
+      for (int b=0; b<count; b++) {
+        for (int c=0; c<count; c++) {
+          for (int d=0; d<count; d++) {
+            if (a == b || a == c || a == d || b == c || b == d || c == d) {
+              continue;
+            }
+            hand[0] = cards[a];
+            hand[1] = cards[b];
+            hand[2] = cards[c];
+            hand[3] = cards[d];
+            visit();
+          }
+        }
+      }
+    }
+  }
+
+  OrderPolicy p1_policy, p2_policy;
+  int p1_orders, p2_orders; //24 for a policy that picks at random (every order is followed), 1 for a deterministic one
+  AnalysisOptions options;
+  Rng unusedRng; //passed to the deterministic policies, which do not draw from it
+};
+
+/*samplePosition
+Purpose: estimating how a position goes on by playing games from it with random deck orders
+Parameters: the position, both players' policies, options (number of games and seed)
+Return: win rates and mean battles left, with 95% confidence intervals
+*/
+inline AnalysisResult samplePosition(const Position &position, OrderPolicy p1_policy, OrderPolicy p2_policy, const AnalysisOptions &options) {
+  AnalysisResult result = {};
+  result.samples = options.samples;
+  long long p1Wins = 0, p2Wins = 0, unfinished = 0;
+  double totalBattles = 0, totalSquares = 0;
+  Card cards[NUM_CARDS];
+  for (long long i=0; i<options.samples; i++) {
+    Rng rng(options.seed, i);
+    SimPlayer p1, p2;
+    uint64_t piles[4] = {position.p1Deck, position.p1Discard, position.p2Deck, position.p2Discard};
+    CardPile *targets[4] = {&p1.deck, &p1.discard, &p2.deck, &p2.discard};
+    for (int p=0; p<4; p++) {
+      int count = 0;
+      for (uint64_t bits = piles[p]; bits != 0; bits &= bits - 1) {
+        cards[count++] = __builtin_ctzll(bits);
+      }
+      shuffleInPlace(cards, count, rng); //decks only need this, but it keeps every pile in the same form
+      targets[p]->assign(cards, count);
+    }
+    NoRecorder recorder;
+    GameResult game = continueGame(p1, p2, p1_policy, p2_policy, rng, ANALYZER_MAX_BATTLES, recorder);
+    p1Wins += game.winner == 1;
+    p2Wins += game.winner == 2;
+    unfinished += game.winner == 0;
+    totalBattles += game.battles;
+    totalSquares += (double)game.battles * game.battles;
+  }
+  double n = options.samples;
+  result.p1Win = p1Wins / n;
+  result.p2Win = p2Wins / n;
+  result.unfinished = unfinished / n;
+  result.battles = totalBattles / n;
+  result.p1WinError = 1.96 * std::sqrt(result.p1Win * (1 - result.p1Win) / n);
+  result.battlesError = 1.96 * std::sqrt(std::max(0.0, totalSquares / n - result.battles * result.battles) / n);
+  return result;
+}
+
+/*analyzePosition
+Purpose: working out how a position goes on, exactly if the exact search can finish within its limits, otherwise by sampling games
+Parameters: a valid position (see isValidPosition), both players' policies, options
+Return: win probabilities and expected battles left, and how they were found
+*/
+inline AnalysisResult analyzePosition(const Position &position, OrderPolicy p1_policy, OrderPolicy p2_policy, const AnalysisOptions &options) {
+  AnalysisResult result = {};
+  result.exact = true;
+  if (position.p1Cards() < SIM_HAND_SIZE || position.p2Cards() < SIM_HAND_SIZE) { //already decided (P1 is checked first, as in main())
+    result.p1Win = position.p1Cards() < SIM_HAND_SIZE ? 0 : 1;
+    result.p2Win = 1 - result.p1Win;
+    return result;
+  }
+  ExactSearch search(p1_policy, p2_policy, options);
+  Outcome outcome;
+  bool finished = search.evaluate(position, options.horizon, outcome);
+  if (finished) {
+    result.p1Win = outcome.p1Win;
+    result.p2Win = outcome.p2Win;
+    result.unfinished = std::max(0.0, 1 - outcome.p1Win - outcome.p2Win);
+    result.battles = outcome.battles;
+  }
+  else {
+    result = samplePosition(position, p1_policy, p2_policy, options);
+  }
+  result.expansions = search.expansions;
+  result.cacheHits = search.cache.hits;
+  result.cacheMisses = search.cache.misses;
+  result.cacheEvictions = search.cache.evictions;
+  result.cacheBytes = search.cache.bytes();
+  return result;
+}
+
+#endif
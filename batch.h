@@ -0,0 +1,162 @@
+#ifndef WARGAME_BATCH_H
+#define WARGAME_BATCH_H
+
+#include <vector>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "simulation.h"
+
+/*BATCHED SUB-BATTLES
+Runs many independent games in lock step and decides the sub-battles of all of them together.
+The cards played are kept as a structure of arrays (played[k][lane] is the card played in sub-battle k of the game in that lane), so one SIMD compare decides sub-battle k for 32 games (AVX2) or 16 games (SSE2) at once.
+Each game gets a 4-bit win mask (bit k set if P1 wins sub-battle k) that routes the cards to the winner's discard pile.
+The instruction set is chosen at compile time (build with -mavx2 or -march=native for AVX2); without SSE2/AVX2 a scalar loop is used.
+Cards are 0-51, so signed byte comparisons give the same answer as comparing the cards.
+*/
+
+const int BATCH_LANES = 64; //games in flight at once, a multiple of 32 (small enough that every lane's decks stay in L1)
+
+struct alignas(32) SubBattleBatch {
+  Card p1Played[SIM_HAND_SIZE][BATCH_LANES];
+  Card p2Played[SIM_HAND_SIZE][BATCH_LANES];
+  unsigned char p1WinMask[BATCH_LANES];
+};
+
+/*compareSubBattlesScalar
+Purpose: computing the P1 win masks one game at a time (the reference the vector versions are checked against)
+Parameters: batch of played cards, number of lanes to compare
+*/
+inline void compareSubBattlesScalar(SubBattleBatch &batch, int numLanes) {
+  for (int lane=0; lane<numLanes; lane++) {
+    unsigned char mask = 0;
+    for (int k=0; k<SIM_HAND_SIZE; k++) {
+      if (batch.p1Played[k][lane] > batch.p2Played[k][lane]) {
+        mask |= 1 << k;
+      }
+    }
+    batch.p1WinMask[lane] = mask;
+  }
+}
+
+/*compareSubBattles
+Purpose: computing the P1 win masks with the widest vector instructions available
+Parameters: batch of played cards, number of lanes to compare (lanes are processed in whole vectors, so up to 31 lanes past numLanes are also written)
+*/
+inline void compareSubBattles(SubBattleBatch &batch, int numLanes) {
+#if defined(__AVX2__)
+  for (int lane=0; lane<numLanes; lane+=32) {
+    __m256i mask = _mm256_setzero_si256();
+    for (int k=0; k<SIM_HAND_SIZE; k++) {
+      __m256i p1 = _mm256_load_si256((const __m256i *)&batch.p1Played[k][lane]);
+      __m256i p2 = _mm256_load_si256((const __m256i *)&batch.p2Played[k][lane]);
+      __m256i p1Wins = _mm256_cmpgt_epi8(p1, p2); //0xFF in every lane where P1's card is stronger
+      mask = _mm256_or_si256(mask, _mm256_and_si256(p1Wins, _mm256_set1_epi8(1 << k)));
+    }
+    _mm256_store_si256((__m256i *)&batch.p1WinMask[lane], mask);
+  }
+#elif defined(__SSE2__)
+  for (int lane=0; lane<numLanes; lane+=16) {
+    __m128i mask = _mm_setzero_si128();
+    for (int k=0; k<SIM_HAND_SIZE; k++) {
+      __m128i p1 = _mm_load_si128((const __m128i *)&batch.p1Played[k][lane]);
+      __m128i p2 = _mm_load_si128((const __m128i *)&batch.p2Played[k][lane]);
+      __m128i p1Wins = _mm_cmpgt_epi8(p1, p2);
+      mask = _mm_or_si128(mask, _mm_and_si128(p1Wins, _mm_set1_epi8(1 << k)));
+    }
+    _mm_store_si128((__m128i *)&batch.p1WinMask[lane], mask);
+  }
+#else
+  compareSubBattlesScalar(batch, numLanes);
+#endif
+}
+
+/*batchInstructionSet
+Purpose: naming the instruction set compareSubBattles was compiled for (for benchmark output)
+*/
+inline const char *batchInstructionSet() {
+#if defined(__AVX2__)
+  return "AVX2";
+#elif defined(__SSE2__)
+  return "SSE2";
+#else
+  return "scalar";
+#endif
+}
+
+/*runSimulationBatched
+Purpose: playing the same games as runSimulation (game i on stream i of the seed, same rules and random draws, so the statistics are identical), BATCH_LANES games at a time with the sub-battles of each battle decided by compareSubBattles
+Each battle is continueGame's own two halves (drawBattle and settleBattle in simulation.h) with the sub-battles of every lane decided in between
+Parameters: number of games, master seed, both players' policies, number of battles after which a game is abandoned, number of the first game
+Return: aggregate win and game-length statistics
+*/
+inline SimStats runSimulationBatched(long long games, uint64_t seed, OrderPolicy p1_policy, OrderPolicy p2_policy, int maxBattles = SIM_DEFAULT_MAX_BATTLES, long long firstGame = 0) {
+  struct Lane {
+    SimPlayer p1, p2;
+    Rng rng;
+    GameResult result;
+    Card played[2][SIM_HAND_SIZE];
+    bool active;
+  };
+  std::vector<Lane> lanes(BATCH_LANES);
+  std::vector<SubBattleBatch> batchStorage(1); //heap-allocated and 32-byte aligned (C++17 aligned new)
+  SubBattleBatch &batch = batchStorage[0];
+  SimStats stats;
+  NoRecorder recorder;
+  int tiebreaks = 0; //only used by the instrumentation (optimized away without it)
+  long long nextGame = firstGame, endGame = firstGame + games;
+
+  //Start the next unplayed game in a lane, or leave the lane idle if every game has been started
+  auto startGame = [&](Lane &lane) {
+    lane.active = nextGame < endGame;
+    if (lane.active) {
+      lane.rng = Rng(seed, nextGame++);
+      dealGame(lane.p1, lane.p2, lane.rng);
+      lane.result = {0, 0, 0};
+    }
+  };
+  int numLanes = 0, numActive = 0;
+  for (Lane &lane : lanes) {
+    startGame(lane);
+    if (lane.active) {
+      numLanes++;
+    }
+  }
+  numActive = numLanes;
+
+  while (numActive > 0) {
+    //Each game's battle up to the cards meeting
+    for (int l=0; l<numLanes; l++) {
+      Lane &lane = lanes[l];
+      if (!lane.active) {
+        continue;
+      }
+      drawBattle(lane.p1, lane.p2, p1_policy, p2_policy, lane.rng, lane.result, recorder, lane.played);
+      for (int k=0; k<SIM_HAND_SIZE; k++) {
+        batch.p1Played[k][l] = lane.played[0][k];
+        batch.p2Played[k][l] = lane.played[1][k];
+      }
+    }
+    //All sub-battles of all games at once
+    compareSubBattles(batch, numLanes);
+    //Route the cards with the win masks and check for a loser
+    for (int l=0; l<numLanes; l++) {
+      Lane &lane = lanes[l];
+      if (!lane.active) {
+        continue;
+      }
+      if (settleBattle(lane.p1, lane.p2, lane.played, batch.p1WinMask[l], lane.result, tiebreaks) || lane.result.battles >= maxBattles) {
+        stats.record(lane.result);
+        instrumentGame(lane.result);
+        startGame(lane);
+        if (!lane.active) {
+          numActive--;
+        }
+      }
+    }
+  }
+  INSTRUMENT_ADD(INSTRUMENT_SUIT_TIEBREAKS, tiebreaks);
+  return stats;
+}
+
+#endif
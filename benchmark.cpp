@@ -0,0 +1,889 @@
+//Benchmarks and statistical checks for the game and simulation hot paths
+//Build (next to the game): g++ -std=c++17 -O2 -march=native benchmark.cpp -o benchmark
+//Usage: benchmark [--json <file>] [--baseline <file>] [--no-checks] [benchmark name prefix ...]
+//  --json writes one JSON object per benchmark to the file; --baseline prints the change in ns/op against a file written by --json (e.g. from an earlier commit)
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <chrono>
+#define WARGAME_NO_MAIN
+#include "wargame.cpp" //the game itself, so compareCards() and the GameFlow state machine are timed as they are
+#include "analyzer.h"
+#include "batch.h"
+#include "card.h"
+#include "deck.h"
+#include "random.h"
+#include "session.h"
+#include "simulation.h"
+#include "solver.h"
+#include "tuning.h"
+#include "variant.h"
+using namespace std;
+
+//Written to so the optimizer cannot remove the work being timed
+volatile unsigned sink;
+
+/*ALLOCATION COUNTING
+Every operator new in this program goes through the replacements below, so each benchmark can report heap allocations per operation.
+The counter is atomic because some checks (the session and tuning ones) run games on several threads; relaxed increments are enough for a count.
+*/
+atomic<long long> allocationCount(0);
+
+void *operator new(size_t size) {
+  allocationCount.fetch_add(1, memory_order_relaxed);
+  void *memory = malloc(size == 0 ? 1 : size);
+  if (memory == nullptr) {
+    throw bad_alloc();
+  }
+  return memory;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new(size_t size, align_val_t alignment) {
+  allocationCount.fetch_add(1, memory_order_relaxed);
+  size_t align = (size_t)alignment;
+  void *memory = aligned_alloc(align, (size + align) / align * align); //aligned_alloc needs a multiple of the alignment (and at least one)
+  if (memory == nullptr) {
+    throw bad_alloc();
+  }
+  return memory;
+}
+void *operator new[](size_t size, align_val_t alignment) { return operator new(size, alignment); }
+//Not inlined, so GCC does not see free() meet a pointer from operator new at the call site (-Wmismatched-new-delete); both go through malloc here
+__attribute__((noinline)) void releaseMemory(void *memory) noexcept { free(memory); }
+void operator delete(void *memory) noexcept { releaseMemory(memory); }
+void operator delete[](void *memory) noexcept { releaseMemory(memory); }
+void operator delete(void *memory, size_t) noexcept { releaseMemory(memory); }
+void operator delete[](void *memory, size_t) noexcept { releaseMemory(memory); }
+void operator delete(void *memory, align_val_t) noexcept { releaseMemory(memory); }
+void operator delete[](void *memory, align_val_t) noexcept { releaseMemory(memory); }
+void operator delete(void *memory, size_t, align_val_t) noexcept { releaseMemory(memory); }
+void operator delete[](void *memory, size_t, align_val_t) noexcept { releaseMemory(memory); }
+
+/*MEASUREMENT*/
+
+struct BenchmarkResult {
+  string name; //e.g. "shuffle/fisher-yates"
+  string unit; //what one operation is, e.g. "game"
+  double nsPerOp, allocationsPerOp, opsPerSecond;
+};
+vector <BenchmarkResult> results;
+vector <string> selectedNames; //name prefixes from the command line; empty runs everything
+
+/*secondsSince
+Purpose: measuring elapsed wall time
+Parameters: start time
+Return: seconds since start
+*/
+double secondsSince(chrono::steady_clock::time_point start) {
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/*isSelected
+Purpose: checking whether a benchmark was asked for on the command line
+*/
+bool isSelected(const string &name) {
+  if (selectedNames.empty()) {
+    return true;
+  }
+  for (const string &prefix : selectedNames) {
+    if (name.compare(0, prefix.size(), prefix) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*measure
+Purpose: timing one benchmark and counting its heap allocations, then printing and storing the result
+Parameters: benchmark name, name of one operation, number of operations body performs, body (does all the operations and returns a checksum)
+*/
+template <typename Body>
+void measure(const string &name, const string &unit, long long ops, Body body) {
+  if (!isSelected(name)) {
+    return;
+  }
+  long long allocationsBefore = allocationCount.load(memory_order_relaxed);
+  auto start = chrono::steady_clock::now();
+  sink = body();
+  double seconds = secondsSince(start);
+  BenchmarkResult result = {name, unit, seconds * 1e9 / ops, (double)(allocationCount.load(memory_order_relaxed) - allocationsBefore) / ops, ops / seconds};
+  results.push_back(result);
+  streamsize precision = cout.precision();
+  cout << fixed << setprecision(2) << left << setw(30) << name << right << setw(12) << result.nsPerOp << " ns/" << left << setw(12) << unit;
+  cout << right << setw(10) << result.allocationsPerOp << " allocs/op" << setw(16) << setprecision(0) << result.opsPerSecond << " " << unit << "s/s" << endl;
+  cout << defaultfloat << setprecision(precision);
+}
+
+/*legacyShuffle
+Purpose: the original wargame.cpp shuffle (copy, reseed with time(0), erase from the middle), kept as the baseline to compare against
+*/
+vector <Card> legacyShuffle(vector <Card> deck) {
+  vector <Card> copyDeck(deck);
+  vector <Card> shuffledDeck;
+  srand(time(0));
+  while (copyDeck.size() > 0) {
+    int removeCard = rand()%copyDeck.size();
+    shuffledDeck.push_back(copyDeck[removeCard]);
+    copyDeck.erase(copyDeck.begin() + removeCard);
+  }
+  return shuffledDeck;
+}
+
+/*dealHands
+Purpose: dealing two random 4-card hands from one deck
+*/
+void dealHands(Rng &rng, Card hand[4], Card opponentHand[4]) {
+  Card cards[NUM_CARDS];
+  for (int i=0; i<NUM_CARDS; i++) {
+    cards[i] = i;
+  }
+  shuffleInPlace(cards, NUM_CARDS, rng);
+  for (int i=0; i<4; i++) {
+    hand[i] = cards[i];
+    opponentHand[i] = cards[4+i];
+  }
+}
+
+/*benchmarkGameSetup
+Purpose: timing a new game session, dealing a war (GameSession::startWar) and the game's own compareCards() (output discarded), plus the original shuffle as a baseline
+*/
+void benchmarkGameSetup() {
+  measure("newSession", "call", 200000, [] {
+    unsigned checksum = 0;
+    for (int i=0; i<200000; i++) {
+      GameSession game(i);
+      game.startWar();
+      checksum += game.players[0].cards.deck[0];
+    }
+    return checksum;
+  });
+
+  vector <Card> deck(NUM_CARDS);
+  for (int i=0; i<NUM_CARDS; i++) {
+    deck[i] = i;
+  }
+  measure("shuffle/legacy", "shuffle", 100000, [&] {
+    for (int i=0; i<100000; i++) {
+      deck = legacyShuffle(deck);
+    }
+    return (unsigned)deck[0];
+  });
+  Rng rng(1);
+  measure("shuffle/fisher-yates", "shuffle", 2000000, [&] {
+    for (int i=0; i<2000000; i++) {
+      shuffleInPlace(deck.data(), deck.size(), rng);
+    }
+    return (unsigned)deck[0];
+  });
+
+  GameFlow flow(1, -1);
+  flow.screen.setMode(Renderer::OFF);
+  GameSession &game = flow.game;
+  measure("startWar", "call", 1000000, [&] {
+    unsigned checksum = 0;
+    for (int i=0; i<1000000; i++) {
+      game.startWar();
+      checksum += game.players[0].cards.deck[0];
+    }
+    return checksum;
+  });
+
+  //Random 4-card plays for both players, so the branch in compareCards() is unpredictable; the decks keep their 26 cards, so no war ends
+  const int PLAYS = 1024;
+  vector <Card> plays(PLAYS * 8);
+  for (int i=0; i<PLAYS; i++) {
+    dealHands(rng, &plays[i*8], &plays[i*8+4]);
+  }
+  const unsigned char *drawnOrder = ORDER_PERMUTATIONS[0];
+  measure("compareCards", "call", 2000000, [&] {
+    unsigned checksum = 0;
+    for (int i=0; i<2000000; i++) {
+      game.players[0].cards.discard.clear();
+      game.players[1].cards.discard.clear();
+      memcpy(game.hands, &plays[(i % PLAYS) * 8], 8);
+      flow.compareCards(drawnOrder, drawnOrder);
+      checksum += game.players[0].cards.discard.size();
+    }
+    return checksum;
+  });
+}
+
+/*legacyBattles
+Purpose: playing games with the original vector bookkeeping from battle() (erase the top 4 cards, push_back the winnings, insert + copy + clear to reshuffle); every sub-battle is played in drawn order so only the deck handling differs from cardPileBattles
+Parameters: number of battles to play, random number generator
+Return: checksum of the cards drawn
+*/
+unsigned legacyBattles(int numBattles, Rng &rng) {
+  vector <Card> decks[2], discards[2];
+  unsigned checksum = 0;
+  for (int battle=0; battle<numBattles; battle++) {
+    if (decks[0].size() + discards[0].size() < 4 || decks[1].size() + discards[1].size() < 4) { //someone lost (or first battle): deal a new game
+      Card fullDeck[NUM_CARDS];
+      for (int i=0; i<NUM_CARDS; i++) {
+        fullDeck[i] = i;
+      }
+      shuffleInPlace(fullDeck, NUM_CARDS, rng);
+      decks[0].assign(fullDeck, fullDeck + NUM_CARDS/2);
+      decks[1].assign(fullDeck + NUM_CARDS/2, fullDeck + NUM_CARDS);
+      discards[0].clear();
+      discards[1].clear();
+    }
+    for (int p=0; p<2; p++) {
+      if (decks[p].size() < 4) {
+        discards[p].insert(discards[p].end(), decks[p].begin(), decks[p].end());
+        shuffleInPlace(discards[p].data(), discards[p].size(), rng);
+        decks[p] = discards[p];
+        discards[p].clear();
+      }
+    }
+    Card hands[2][4] = {{decks[0][0], decks[0][1], decks[0][2], decks[0][3]}, {decks[1][0], decks[1][1], decks[1][2], decks[1][3]}};
+    decks[0].erase(decks[0].begin(), decks[0].begin()+4);
+    decks[1].erase(decks[1].begin(), decks[1].begin()+4);
+    for (int i=0; i<4; i++) {
+      vector <Card> &winner = hands[0][i] > hands[1][i] ? discards[0] : discards[1];
+      winner.push_back(hands[0][i]);
+      winner.push_back(hands[1][i]);
+      checksum += hands[0][i];
+    }
+  }
+  return checksum;
+}
+
+/*cardPileBattles
+Purpose: the same games as legacyBattles, using CardPile for every deck and discard pile
+*/
+unsigned cardPileBattles(int numBattles, Rng &rng) {
+  CardPile decks[2], discards[2];
+  unsigned checksum = 0;
+  for (int battle=0; battle<numBattles; battle++) {
+    if (decks[0].size() + discards[0].size() < 4 || decks[1].size() + discards[1].size() < 4) {
+      Card fullDeck[NUM_CARDS];
+      for (int i=0; i<NUM_CARDS; i++) {
+        fullDeck[i] = i;
+      }
+      shuffleInPlace(fullDeck, NUM_CARDS, rng);
+      decks[0].assign(fullDeck, NUM_CARDS/2);
+      decks[1].assign(fullDeck + NUM_CARDS/2, NUM_CARDS/2);
+      discards[0].clear();
+      discards[1].clear();
+    }
+    for (int p=0; p<2; p++) {
+      if (decks[p].size() < 4) {
+        discards[p].appendFrom(decks[p]);
+        discards[p].shuffle(rng);
+        decks[p].swap(discards[p]);
+      }
+    }
+    Card hands[2][4];
+    decks[0].draw(hands[0], 4);
+    decks[1].draw(hands[1], 4);
+    for (int i=0; i<4; i++) {
+      CardPile &winner = hands[0][i] > hands[1][i] ? discards[0] : discards[1];
+      winner.pushPair(hands[0][i], hands[1][i]);
+      checksum += hands[0][i];
+    }
+  }
+  return checksum;
+}
+
+/*benchmarkBattle
+Purpose: timing the per-battle deck bookkeeping (draw 4, add winnings, reshuffle) with vectors and with CardPile
+*/
+void benchmarkBattle() {
+  const int BATTLES = 5000000;
+  unsigned legacyChecksum = 0, cardPileChecksum = 0;
+  measure("battle/vector", "battle", BATTLES, [&] {
+    Rng rng(7);
+    return legacyChecksum = legacyBattles(BATTLES, rng);
+  });
+  measure("battle/cardpile", "battle", BATTLES, [&] {
+    Rng rng(7);
+    return cardPileChecksum = cardPileBattles(BATTLES, rng);
+  });
+  if (legacyChecksum != cardPileChecksum && isSelected("battle/vector") && isSelected("battle/cardpile")) {
+    cout << "[MISMATCH: the two battle versions played different games]" << endl;
+  }
+}
+
+/*checkSolver
+Purpose: comparing the table-driven best response, maximin order and minimax value with a brute-force search of the full 24x24 payoff matrix
+Return: true if every answer matches
+*/
+bool checkSolver() {
+  const int TRIALS = 200000;
+  Rng rng(31);
+  int mismatches = 0;
+  for (int t=0; t<TRIALS; t++) {
+    Card hand[4], opponentHand[4];
+    dealHands(rng, hand, opponentHand);
+    unsigned char payoff[NUM_ORDERS][NUM_ORDERS];
+    payoffMatrix(hand, opponentHand, payoff);
+    int theirs = rng.bounded(NUM_ORDERS);
+    int bruteBest = 0, bruteMaximin = 0, total = 0;
+    for (int a=0; a<NUM_ORDERS; a++) {
+      int worst = 4;
+      for (int b=0; b<NUM_ORDERS; b++) {
+        worst = min(worst, (int)payoff[a][b]);
+        total += payoff[a][b];
+      }
+      bruteBest = max(bruteBest, (int)payoff[a][theirs]);
+      bruteMaximin = max(bruteMaximin, worst);
+    }
+    unsigned char order[4];
+    int best = bestResponse(hand, opponentHand, ORDER_PERMUTATIONS[theirs], order);
+    int achieved = 0;
+    for (int k=0; k<4; k++) {
+      achieved += hand[order[k]] > opponentHand[ORDER_PERMUTATIONS[theirs][k]];
+    }
+    int guaranteed = maximinOrder(hand, opponentHand, order);
+    if (best != bruteBest || achieved != bruteBest || guaranteed != bruteMaximin || minimaxValue(hand, opponentHand) * NUM_ORDERS * NUM_ORDERS != total) {
+      mismatches++;
+    }
+  }
+  cout << "solver vs brute force: " << mismatches << " mismatches in " << TRIALS << " hands" << endl;
+  return mismatches == 0;
+}
+
+/*benchmarkSolver
+Purpose: timing a table-driven best-response decision and the brute-force 24x24 search it replaces
+*/
+void benchmarkSolver() {
+  const int HANDS = 1024, ITERATIONS = 2000;
+  Rng rng(5);
+  vector <Card> hands(HANDS*8);
+  for (int h=0; h<HANDS; h++) {
+    dealHands(rng, &hands[h*8], &hands[h*8+4]);
+  }
+  measure("bestResponse/tables", "decision", (long long)HANDS * ITERATIONS, [&] {
+    unsigned checksum = 0;
+    for (int i=0; i<ITERATIONS; i++) {
+      for (int h=0; h<HANDS; h++) {
+        unsigned char order[4];
+        checksum += bestResponse(&hands[h*8], &hands[h*8+4], ORDER_PERMUTATIONS[0], order);
+      }
+    }
+    return checksum;
+  });
+  measure("bestResponse/brute-force", "decision", (long long)HANDS * (ITERATIONS/20), [&] {
+    unsigned checksum = 0;
+    for (int i=0; i<ITERATIONS/20; i++) {
+      for (int h=0; h<HANDS; h++) {
+        unsigned char payoff[NUM_ORDERS][NUM_ORDERS];
+        payoffMatrix(&hands[h*8], &hands[h*8+4], payoff);
+        int best = 0;
+        for (int a=0; a<NUM_ORDERS; a++) {
+          best = max(best, (int)payoff[a][0]);
+        }
+        checksum += best;
+      }
+    }
+    return checksum;
+  });
+}
+
+/*checkBatch
+Purpose: checking the vectorized sub-battle masks against the scalar rules for every pair of cards and for random batches, and checking that batched games give exactly the statistics of runSimulation
+Return: true if everything matches
+*/
+bool checkBatch() {
+  vector <SubBattleBatch> vectorBatch(1), scalarBatch(1);
+  Rng rng(8);
+  int mismatches = 0;
+  //Every (P1 card, P2 card) pair, spread over the lanes and the 4 sub-battle slots, plus random batches
+  int pair = 0;
+  for (int trial=0; trial<1000; trial++) {
+    for (int k=0; k<SIM_HAND_SIZE; k++) {
+      for (int lane=0; lane<BATCH_LANES; lane++) {
+        Card p1, p2;
+        if (pair < NUM_CARDS * NUM_CARDS) {
+          p1 = pair / NUM_CARDS;
+          p2 = pair % NUM_CARDS;
+          pair++;
+        }
+        else {
+          p1 = rng.bounded(NUM_CARDS);
+          p2 = rng.bounded(NUM_CARDS);
+        }
+        vectorBatch[0].p1Played[k][lane] = scalarBatch[0].p1Played[k][lane] = p1;
+        vectorBatch[0].p2Played[k][lane] = scalarBatch[0].p2Played[k][lane] = p2;
+      }
+    }
+    compareSubBattles(vectorBatch[0], BATCH_LANES);
+    compareSubBattlesScalar(scalarBatch[0], BATCH_LANES);
+    for (int lane=0; lane<BATCH_LANES; lane++) {
+      if (vectorBatch[0].p1WinMask[lane] != scalarBatch[0].p1WinMask[lane]) {
+        mismatches++;
+      }
+    }
+  }
+  cout << "sub-battle masks (" << batchInstructionSet() << ") vs scalar: " << mismatches << " mismatches in " << 1000 * BATCH_LANES << " games" << endl;
+
+  SimStats single = runSimulation(5000, 4, greedyOrder, randomOrder);
+  SimStats batched = runSimulationBatched(5000, 4, greedyOrder, randomOrder);
+  bool sameGames = single.p1Wins == batched.p1Wins && single.totalBattles == batched.totalBattles && single.totalReshuffles == batched.totalReshuffles && single.maxBattles == batched.maxBattles;
+  cout << "batched games match runSimulation: " << (sameGames ? "yes" : "NO") << endl;
+  return mismatches == 0 && sameGames;
+}
+
+/*benchmarkBatch
+Purpose: timing sub-battle comparison, scalar and vectorized
+*/
+void benchmarkBatch() {
+  const int ITERATIONS = 200000;
+  vector <SubBattleBatch> batch(1);
+  Rng rng(9);
+  for (int k=0; k<SIM_HAND_SIZE; k++) {
+    for (int lane=0; lane<BATCH_LANES; lane++) {
+      batch[0].p1Played[k][lane] = rng.bounded(NUM_CARDS);
+      batch[0].p2Played[k][lane] = rng.bounded(NUM_CARDS);
+    }
+  }
+  long long subBattles = (long long)ITERATIONS * BATCH_LANES * SIM_HAND_SIZE;
+  measure("subBattles/scalar", "sub-battle", subBattles, [&] {
+    unsigned checksum = 0;
+    for (int i=0; i<ITERATIONS; i++) {
+      compareSubBattlesScalar(batch[0], BATCH_LANES);
+      checksum += batch[0].p1WinMask[i % BATCH_LANES];
+      batch[0].p1Played[0][i % BATCH_LANES] ^= 1; //a small change each time so the loop cannot be hoisted
+    }
+    return checksum;
+  });
+  measure(string("subBattles/") + batchInstructionSet(), "sub-battle", subBattles, [&] {
+    unsigned checksum = 0;
+    for (int i=0; i<ITERATIONS; i++) {
+      compareSubBattles(batch[0], BATCH_LANES);
+      checksum += batch[0].p1WinMask[i % BATCH_LANES];
+      batch[0].p1Played[0][i % BATCH_LANES] ^= 1;
+    }
+    return checksum;
+  });
+}
+
+/*benchmarkGames
+Purpose: timing whole headless games: the engine one game at a time and batched, with cheap and expensive policies, and the interactive game's own state machine (GameFlow) with two computer players and with two humans fed one line at a time, output discarded
+*/
+void benchmarkGames() {
+  const int GAMES = 50000;
+  measure("game/random", "game", GAMES, [] {
+    unsigned checksum = 0;
+    for (int i=0; i<GAMES; i++) {
+      Rng rng(3, i);
+      checksum += playGame(randomOrder, randomOrder, rng).battles;
+    }
+    return checksum;
+  });
+  measure("game/random-batched", "game", GAMES, [] {
+    return (unsigned)runSimulationBatched(GAMES, 3, randomOrder, randomOrder).totalBattles;
+  });
+  measure("game/greedy-counter", "game", GAMES/5, [] {
+    unsigned checksum = 0;
+    for (int i=0; i<GAMES/5; i++) {
+      Rng rng(3, i);
+      checksum += playGame(greedyOrder, counterGreedyPolicy, rng).battles;
+    }
+    return checksum;
+  });
+  measure("game/tuned-greedy", "game", GAMES/5, [] {
+    WeightedPolicy tuned = {TUNED_WEIGHTS};
+    unsigned checksum = 0;
+    for (int i=0; i<GAMES/5; i++) {
+      Rng rng(3, i);
+      checksum += playGame(tuned, greedyOrder, rng).battles;
+    }
+    return checksum;
+  });
+  measure("game/variant-classic", "game", GAMES, [] {
+    const VariantPolicy<ClassicRules> policies[2] = {variantRandomOrder<ClassicRules>, variantRandomOrder<ClassicRules>};
+    return (unsigned)runVariantSimulation<ClassicRules>(GAMES, 3, policies).lengths.totalBattles;
+  });
+  measure("game/variant-4-player", "game", GAMES/5, [] {
+    typedef WarRules<4, 4> FourPlayers;
+    VariantPolicy<FourPlayers> policies[4];
+    fill(policies, policies+4, variantRandomOrder<FourPlayers>);
+    return (unsigned)runVariantSimulation<FourPlayers>(GAMES/5, 3, policies).lengths.totalBattles;
+  });
+
+  //The interactive game's own state machine (GameFlow) with two computer players: each YES plays a whole war
+  GameFlow computers(3, -1);
+  computers.screen.setMode(Renderer::OFF);
+  for (const char *line : {"", "", "", "", "", "2", "2"}) { //instructions, then P1 and P2 are Computer (Easy), which plays the random policy
+    computers.input(line);
+  }
+  measure("game/interactive", "game", GAMES/5, [&] {
+    unsigned checksum = 0;
+    for (int i=0; i<GAMES/5; i++) {
+      computers.input("YES");
+      checksum += computers.game.battleNum;
+    }
+    return checksum;
+  });
+
+  //Two human players, one line of input at a time as the server feeds it (order, order, ENTER per battle): the cost of a prompt without the sockets
+  GameFlow humans(3, -1);
+  humans.screen.setMode(Renderer::OFF);
+  for (const char *line : {"", "", "", "", "", "1", "P1", "1", "1", "P2", "2", ""}) {
+    humans.input(line);
+  }
+  string orderLines[NUM_ORDERS]; //every order as a player types it, e.g. "3142"
+  for (int o=0; o<NUM_ORDERS; o++) {
+    for (int i=0; i<4; i++) {
+      orderLines[o] += (char)('1' + ORDER_PERMUTATIONS[o][i]);
+    }
+  }
+  const int LINES = 500000;
+  measure("game/interactive-input", "line", LINES, [&] {
+    Rng rng(3);
+    for (int i=0; i<LINES; i++) {
+      switch (humans.getState()) {
+        case GameFlow::ORDER:
+          humans.input(orderLines[rng.bounded(NUM_ORDERS)]);
+          break;
+        case GameFlow::AGAIN:
+          humans.input("YES");
+          break;
+        default: //ENTER
+          humans.input("");
+      }
+    }
+    return (unsigned)humans.game.warNum;
+  });
+}
+
+/*chiSquareZ
+Purpose: turning a chi-square statistic into an approximate z-score (how many standard deviations it is from what a uniform shuffle gives)
+Parameters: observed counts, expected count per cell, degrees of freedom
+*/
+double chiSquareZ(const vector <long long> &counts, double expected, int degreesOfFreedom) {
+  double chiSquare = 0;
+  for (long long count : counts) {
+    chiSquare += (count - expected) * (count - expected) / expected;
+  }
+  return (chiSquare - degreesOfFreedom) / sqrt(2.0 * degreesOfFreedom);
+}
+
+/*checkUniformity
+Purpose: chi-square tests that shuffles are uniform: every card is equally likely in every position of a 52-card deck, every one of the 24 orders of a 4-card pile is equally likely, and the first shuffle of consecutive streams is just as uniform (so per-game streams are independent)
+Return: true if every |z| is below 4
+*/
+bool checkUniformity() {
+  const int TRIALS = 2000000;
+  bool passed = true;
+
+  //Card-by-position counts for one long stream
+  vector <long long> positionCounts(NUM_CARDS * NUM_CARDS, 0);
+  Rng rng(12345);
+  Card cards[NUM_CARDS];
+  for (int t=0; t<TRIALS/10; t++) {
+    for (int i=0; i<NUM_CARDS; i++) {
+      cards[i] = i;
+    }
+    shuffleInPlace(cards, NUM_CARDS, rng);
+    for (int i=0; i<NUM_CARDS; i++) {
+      positionCounts[i*NUM_CARDS + cards[i]]++;
+    }
+  }
+  double z = chiSquareZ(positionCounts, (double)(TRIALS/10) / NUM_CARDS, (NUM_CARDS-1) * (NUM_CARDS-1));
+  cout << "uniformity, card x position (52 cards): z = " << z << endl;
+  passed = passed && fabs(z) < 4;
+
+  //Counts of each of the 24 orders, for one long stream and for the first shuffle of each of many streams
+  for (int perStream=0; perStream<2; perStream++) {
+    vector <long long> orderCounts(24, 0);
+    for (int t=0; t<TRIALS; t++) {
+      Rng streamRng(777, t);
+      Rng &useRng = perStream ? streamRng : rng;
+      Card hand[4] = {0, 1, 2, 3};
+      shuffleInPlace(hand, 4, useRng);
+      for (int p=0; p<24; p++) {
+        if (hand[0] == ORDER_PERMUTATIONS[p][0] && hand[1] == ORDER_PERMUTATIONS[p][1] && hand[2] == ORDER_PERMUTATIONS[p][2]) {
+          orderCounts[p]++;
+          break;
+        }
+      }
+    }
+    z = chiSquareZ(orderCounts, (double)TRIALS / 24, 23);
+    cout << "uniformity, 24 orders of 4 cards (" << (perStream ? "first shuffle of each stream" : "one stream") << "): z = " << z << endl;
+    passed = passed && fabs(z) < 4;
+  }
+  return passed;
+}
+
+/*checkReproducible
+Purpose: confirming that a simulation batch gives identical results when rerun from the same seed, including when it is split into separate batches
+*/
+bool checkReproducible() {
+  SimStats whole = runSimulation(20000, 99, randomOrder, randomOrder);
+  SimStats firstHalf = runSimulation(10000, 99, randomOrder, randomOrder, SIM_DEFAULT_MAX_BATTLES, 0);
+  SimStats secondHalf = runSimulation(10000, 99, randomOrder, randomOrder, SIM_DEFAULT_MAX_BATTLES, 10000);
+  firstHalf.merge(secondHalf);
+  bool passed = whole.p1Wins == firstHalf.p1Wins && whole.totalBattles == firstHalf.totalBattles && whole.totalReshuffles == firstHalf.totalReshuffles;
+  cout << "reproducible from seed: " << (passed ? "yes" : "NO") << endl;
+  return passed;
+}
+
+/*checkAnalyzer
+Purpose: comparing the exact search's chances of each player winning within 2 battles with the rates in sampled games played from the same position
+Return: true if both sampled rates are within 4 standard errors of the exact probabilities and both are well away from 0, so each half of the comparison can fail
+*/
+bool checkAnalyzer() {
+  const int HORIZON = 2, SAMPLES = 200000;
+  //An endgame with only 10 cards left in play, 5 in each deck (the search only looks at the cards that are there): P1 is out after the first battle if it wins at most 1 sub-battle and P2 if P1 wins 3 or more; after 2-2 both shuffle all 5 of their cards and play once more
+  //P1 plays greedyOrder, which picks at random without P2's hand, so the search follows all 24 of P1's orders; P2 replies with the maximin order
+  Card p1_deck[5] = {4, 17, 26, 38, 49}, p2_deck[5] = {9, 21, 30, 42, 46};
+  Position position = {0, 0, 0, 0};
+  for (int i=0; i<5; i++) {
+    position.p1Deck |= 1ULL << p1_deck[i];
+    position.p2Deck |= 1ULL << p2_deck[i];
+  }
+  AnalysisOptions options;
+  options.horizon = HORIZON;
+  ExactSearch search(greedyOrder, counterGreedyPolicy, options);
+  Outcome exact = {0, 0, 0};
+  bool finished = search.evaluate(position, HORIZON, exact);
+
+  long long p1Wins = 0, p2Wins = 0;
+  Card cards[NUM_CARDS];
+  for (int i=0; i<SAMPLES; i++) {
+    Rng rng(21, i);
+    SimPlayer p1, p2;
+    uint64_t piles[4] = {position.p1Deck, position.p1Discard, position.p2Deck, position.p2Discard};
+    CardPile *targets[4] = {&p1.deck, &p1.discard, &p2.deck, &p2.discard};
+    for (int p=0; p<4; p++) {
+      int count = 0;
+      for (int c=0; c<NUM_CARDS; c++) {
+        if ((piles[p] >> c) & 1) {
+          cards[count++] = c;
+        }
+      }
+      shuffleInPlace(cards, count, rng);
+      targets[p]->assign(cards, count);
+    }
+    NoRecorder recorder;
+    GameResult game = continueGame(p1, p2, greedyOrder, counterGreedyPolicy, rng, HORIZON, recorder);
+    p1Wins += game.winner == 1;
+    p2Wins += game.winner == 2;
+  }
+  double p1Rate = (double)p1Wins / SAMPLES, p2Rate = (double)p2Wins / SAMPLES;
+  double p1Error = sqrt(exact.p1Win * (1 - exact.p1Win) / SAMPLES), p2Error = sqrt(exact.p2Win * (1 - exact.p2Win) / SAMPLES);
+  Outcome again = {0, 0, 0};
+  search.evaluate(position, HORIZON, again); //answered from the cache
+  bool passed = finished && search.cache.hits > 0 && again.p1Win == exact.p1Win && again.p2Win == exact.p2Win;
+  passed = passed && exact.p1Win > 0.05 && exact.p2Win > 0.05;
+  passed = passed && fabs(p1Rate - exact.p1Win) <= 4 * p1Error && fabs(p2Rate - exact.p2Win) <= 4 * p2Error;
+  cout << "analyzer, ends within " << HORIZON << " battles: exact P1 " << exact.p1Win << " P2 " << exact.p2Win << ", sampled P1 " << p1Rate << " P2 " << p2Rate << " (" << search.expansions << " positions, " << search.cache.hits << " cache hits)" << (passed ? "" : " [MISMATCH]") << endl;
+  return passed;
+}
+
+/*checkVariant
+Purpose: confirming that the generic engine with the classic rules plays exactly the games of playGame (same winner, length and reshuffles from the same stream) for every policy it shares with POLICIES
+*/
+bool checkVariant() {
+  const char *NAMES[] = {"fixed", "random", "ascending", "descending", "greedy"};
+  const int GAMES = 2000;
+  long long mismatches = 0;
+  for (const char *p1_name : NAMES) {
+    for (const char *p2_name : NAMES) {
+      const VariantPolicy<ClassicRules> policies[2] = {findVariantPolicy<ClassicRules>(p1_name), findVariantPolicy<ClassicRules>(p2_name)};
+      for (int i=0; i<GAMES; i++) {
+        Rng rng(17, i), variantRng(17, i);
+        GameResult game = playGame(findPolicy(p1_name), findPolicy(p2_name), rng, TOURNAMENT_MAX_BATTLES);
+        GameResult variant = playVariant<ClassicRules>(policies, variantRng, TOURNAMENT_MAX_BATTLES);
+        mismatches += game.winner != variant.winner || game.battles != variant.battles || game.reshuffles != variant.reshuffles;
+      }
+    }
+  }
+  cout << "variant engine (classic rules) vs playGame: " << mismatches << " mismatches in " << 25 * GAMES << " games" << endl;
+  return mismatches == 0;
+}
+
+/*checkSessions
+Purpose: confirming that game sessions are independent: thousands of sessions played at once on every core end with exactly the scores and battle counts they get when played one after another
+*/
+bool checkSessions() {
+  const int SESSIONS = 4000, WARS = 3;
+  //scores and battles[s] for session s, played sequentially and then in parallel
+  vector <long long> sequential(SESSIONS), parallel(SESSIONS);
+  auto playSession = [](int s) {
+    GameSession game(s);
+    game.players[0].policy = findPolicyIndex("random");
+    game.players[1].policy = findPolicyIndex("greedy");
+    long long battles = 0;
+    for (int w=0; w<WARS; w++) {
+      playComputerWar(game, TOURNAMENT_MAX_BATTLES);
+      battles += game.battleNum;
+    }
+    return battles * 1000 + game.players[0].score / WAR_POINTS * 10 + game.players[1].score / WAR_POINTS;
+  };
+  for (int s=0; s<SESSIONS; s++) {
+    sequential[s] = playSession(s);
+  }
+  WorkStealingPool pool(max(4, defaultThreadCount())); //several threads even on a small machine, so sessions really do interleave
+  auto start = chrono::steady_clock::now();
+  pool.run(SESSIONS, [&](long long s, int) {
+    parallel[s] = playSession(s);
+  });
+  double seconds = secondsSince(start);
+  bool passed = sequential == parallel;
+  cout << "sessions on " << pool.threadCount() << " threads match sequential: " << (passed ? "yes" : "NO") << " (" << SESSIONS << " sessions, " << SESSIONS * WARS / seconds << " wars/s)" << endl;
+  return passed;
+}
+
+/*checkTuning
+Purpose: confirming that the strategy search is reproducible: the same state after 3 generations on one thread, on several threads, and when stopped after 2 generations and resumed from the checkpoint
+*/
+bool checkTuning() {
+  TuningOptions options;
+  options.opponents = {greedyOrder, randomOrder};
+  options.opponentNames = {"greedy", "random"};
+  options.dealsPerCandidate = 300;
+  options.population = 8;
+  options.eliteCount = 3;
+  options.seed = 23;
+  auto sameState = [](const TuningState &a, const TuningState &b) {
+    return a.generation == b.generation && memcmp(&a.mean, &b.mean, sizeof(PolicyWeights)) == 0 && memcmp(&a.spread, &b.spread, sizeof(PolicyWeights)) == 0 && memcmp(&a.best, &b.best, sizeof(PolicyWeights)) == 0 && a.bestWinRate == b.bestWinRate;
+  };
+  options.numThreads = 1;
+  TuningState sequential = startTuning(options);
+  for (int g=0; g<3; g++) {
+    tuningGeneration(options, sequential);
+  }
+  options.numThreads = max(4, defaultThreadCount());
+  TuningState parallel = startTuning(options);
+  for (int g=0; g<3; g++) {
+    tuningGeneration(options, parallel);
+  }
+  //Stop after 2 generations, then carry on from the checkpoint
+  options.checkpointPath = "benchmark-tuning.checkpoint";
+  TuningState stopped = startTuning(options), resumed;
+  tuningGeneration(options, stopped);
+  tuningGeneration(options, stopped);
+  bool resumedOk = saveTuning(options, stopped) && loadTuning(options, resumed).empty();
+  remove(options.checkpointPath.c_str());
+  if (resumedOk) {
+    tuningGeneration(options, resumed);
+  }
+  bool passed = sameState(sequential, parallel) && resumedOk && sameState(sequential, resumed);
+  cout << "strategy search on 1 and " << options.numThreads << " threads and resumed from a checkpoint: " << (passed ? "same" : "DIFFERENT") << " (mean weights win " << setprecision(4) << 100 * evaluateCandidates({sequential.mean}, options, 0)[0] << "% after 3 generations)" << endl;
+  return passed;
+}
+
+/*OUTPUT*/
+
+/*writeJson
+Purpose: writing the results as JSON, one object per line, so runs from different commits can be compared (see readBaseline)
+Parameters: path of the file
+Return: false if the file could not be written
+*/
+bool writeJson(const char *path) {
+  ofstream out(path);
+  for (const BenchmarkResult &result : results) {
+    out << "{\"name\": \"" << result.name << "\", \"unit\": \"" << result.unit << "\", \"ns_per_op\": " << setprecision(6) << result.nsPerOp;
+    out << ", \"allocs_per_op\": " << result.allocationsPerOp << ", \"ops_per_sec\": " << result.opsPerSecond << ", \"instruction_set\": \"" << batchInstructionSet() << "\"}" << "\n";
+  }
+  return (bool)out;
+}
+
+/*readBaseline
+Purpose: reading the ns/op of every benchmark from a file written by writeJson
+Parameters: path of the file
+Return: ns/op by benchmark name (empty if the file cannot be read)
+*/
+map <string, double> readBaseline(const char *path) {
+  map <string, double> baseline;
+  ifstream in(path);
+  string line;
+  while (getline(in, line)) {
+    size_t name = line.find("\"name\": \"");
+    size_t nsPerOp = line.find("\"ns_per_op\": ");
+    if (name == string::npos || nsPerOp == string::npos) {
+      continue;
+    }
+    name += strlen("\"name\": \"");
+    baseline[line.substr(name, line.find('"', name) - name)] = strtod(line.c_str() + nsPerOp + strlen("\"ns_per_op\": "), nullptr);
+  }
+  return baseline;
+}
+
+/*printComparison
+Purpose: printing how much each benchmark's ns/op changed from the baseline (negative is faster)
+*/
+void printComparison(const map <string, double> &baseline) {
+  cout << "\n" << "Change from baseline (ns/op)" << "\n";
+  for (const BenchmarkResult &result : results) {
+    auto found = baseline.find(result.name);
+    cout << left << setw(30) << result.name << right;
+    if (found == baseline.end()) {
+      cout << setw(12) << "new" << "\n";
+      continue;
+    }
+    cout << fixed << setprecision(2) << setw(12) << found->second << " -> " << setw(10) << result.nsPerOp;
+    cout << setw(10) << setprecision(1) << showpos << 100.0 * (result.nsPerOp - found->second) / found->second << "%" << noshowpos << defaultfloat << setprecision(6) << "\n";
+  }
+  cout << flush;
+}
+
+int main(int argc, char *argv[]) {
+  const char *jsonPath = nullptr, *baselinePath = nullptr;
+  bool runChecks = true;
+  for (int i=1; i<argc; i++) {
+    if (strcmp(argv[i], "--json") == 0 && i+1 < argc) {
+      jsonPath = argv[++i];
+    }
+    else if (strcmp(argv[i], "--baseline") == 0 && i+1 < argc) {
+      baselinePath = argv[++i];
+    }
+    else if (strcmp(argv[i], "--no-checks") == 0) {
+      runChecks = false;
+    }
+    else if (argv[i][0] == '-') {
+      cout << "Usage: benchmark [--json <file>] [--baseline <file>] [--no-checks] [benchmark name prefix ...]" << endl;
+      return 1;
+    }
+    else {
+      selectedNames.push_back(argv[i]);
+    }
+  }
+  map <string, double> baseline;
+  if (baselinePath != nullptr) {
+    baseline = readBaseline(baselinePath);
+    if (baseline.empty()) {
+      cout << "Cannot read baseline: " << baselinePath << endl;
+      return 1;
+    }
+  }
+
+  benchmarkGameSetup();
+  benchmarkBattle();
+  benchmarkSolver();
+  benchmarkBatch();
+  benchmarkGames();
+  if (baselinePath != nullptr) {
+    printComparison(baseline);
+  }
+  if (jsonPath != nullptr && !writeJson(jsonPath)) {
+    cout << "Cannot write " << jsonPath << endl;
+    return 1;
+  }
+  if (!runChecks) {
+    return 0;
+  }
+  cout << "\n";
+  bool passed = checkUniformity();
+  passed = checkReproducible() && passed;
+  passed = checkSolver() && passed;
+  passed = checkBatch() && passed;
+  passed = checkAnalyzer() && passed;
+  passed = checkVariant() && passed;
+  passed = checkSessions() && passed;
+  passed = checkTuning() && passed;
+  return passed ? 0 : 1;
+}
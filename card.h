@@ -0,0 +1,57 @@
+#ifndef WARGAME_CARD_H
+#define WARGAME_CARD_H
+
+#include <cctype>
+#include <string>
+
+/*CARD ENCODING
+Each card is a single byte: face*4 + suit, with faces (0 = Deuce ... 12 = Ace) and suits (0 = Spades ... 3 = Clubs) in increasing order of value.
+Because the face is the high part of the byte, comparing two cards is one integer comparison: a larger face wins, and matching faces fall through to the suit tiebreaker (Clubs > Diamonds > Hearts > Spades).
+Names are only built from FACES/SUITS when a card is displayed.
+*/
+
+typedef unsigned char Card;
+
+const int NUM_FACES = 13;
+const int NUM_SUITS = 4;
+const int NUM_CARDS = NUM_FACES * NUM_SUITS;
+
+//Constant string arrays with faces and suits, sorted in increasing order of value
+const std::string FACES[NUM_FACES] = {"Deuce", "Three", "Four", "Five", "Six", "Seven", "Eight", "Nine", "Ten", "Jack", "Queen", "King", "Ace"};
+const std::string SUITS[NUM_SUITS] = {"Spades", "Hearts", "Diamonds", "Clubs"};
+
+inline Card makeCard(int face, int suit) { return (Card)(face*NUM_SUITS + suit); }
+inline int cardFace(Card card) { return card / NUM_SUITS; } //index into FACES
+inline int cardSuit(Card card) { return card % NUM_SUITS; } //index into SUITS
+
+/*cardName
+Purpose: building the display name of a card
+Parameters: the card
+Return: string such as "Ace of Spades"
+*/
+inline std::string cardName(Card card) {
+  return FACES[cardFace(card)] + " of " + SUITS[cardSuit(card)];
+}
+
+/*parseCard
+Purpose: reading a card from its short name: the face (2-9, T or 10, J, Q, K, A) followed by the suit (S, H, D, C), e.g. "QH" or "10C"
+Parameters: the short name
+Return: the card, or -1 if the text is not a card
+*/
+inline int parseCard(std::string text) {
+  const std::string FACE_LETTERS = "23456789TJQKA", SUIT_LETTERS = "SHDC";
+  if (text.size() == 3 && text.compare(0, 2, "10") == 0) {
+    text = "T" + text.substr(2);
+  }
+  if (text.size() != 2) {
+    return -1;
+  }
+  size_t face = FACE_LETTERS.find(toupper(text[0]));
+  size_t suit = SUIT_LETTERS.find(toupper(text[1]));
+  if (face == std::string::npos || suit == std::string::npos) {
+    return -1;
+  }
+  return makeCard(face, suit);
+}
+
+#endif
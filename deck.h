@@ -0,0 +1,123 @@
+#ifndef WARGAME_DECK_H
+#define WARGAME_DECK_H
+
+#include <algorithm>
+#include "card.h"
+#include "random.h"
+
+/*CARD PILE
+A fixed-capacity circular buffer holding up to 52 cards (a deck or a discard pile) in 54 bytes with no heap allocation.
+The top of the pile is at index 0: drawing removes from the top and winning cards are added to the bottom, both in O(1), so battle() no longer shifts the whole deck every time 4 cards are drawn.
+Callers must not draw more cards than the pile holds or add past 52 cards (the game never does: there are only 52 cards).
+The capacity is a template parameter so rule variants with more than one deck (see variant.h) get piles of their own size; CardPile is the 52-card pile used everywhere else.
+*/
+template <int PILE_CAPACITY>
+class BasicCardPile {
+public:
+  static const int CAPACITY = PILE_CAPACITY;
+  static_assert(CAPACITY >= 1 && CAPACITY <= 255, "head and count are single bytes");
+
+  BasicCardPile() : head(0), count(0) {}
+
+  int size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  //Card i from the top of the pile (0 is the top)
+  Card operator[](int i) const { return cards[wrap(head + i)]; }
+
+  /*assign
+  Purpose: replacing the pile's contents with a list of cards (the first card becomes the top)
+  Parameters: array of cards, number of cards
+  */
+  void assign(const Card *newCards, int numCards) {
+    std::copy(newCards, newCards + numCards, cards);
+    head = 0;
+    count = numCards;
+  }
+
+  /*pushBack
+  Purpose: adding a card to the bottom of the pile
+  */
+  void pushBack(Card card) {
+    cards[wrap(head + count)] = card;
+    count++;
+  }
+
+  /*pushBack
+  Purpose: adding cards to the bottom of the pile, first card first
+  Parameters: array of cards, number of cards
+  */
+  void pushBack(const Card *newCards, int numCards) {
+    int tail = head + count;
+    for (int i=0; i<numCards; i++) {
+      cards[wrap(tail + i)] = newCards[i];
+    }
+    count += numCards;
+  }
+
+  /*pushPair
+  Purpose: adding the 2 cards of a sub-battle to the bottom of the pile
+  */
+  void pushPair(Card first, Card second) {
+    cards[wrap(head + count)] = first;
+    cards[wrap(head + count + 1)] = second;
+    count += 2;
+  }
+
+  /*draw
+  Purpose: removing cards from the top of the pile
+  Parameters: array that receives the cards, number of cards to draw
+  */
+  void draw(Card *hand, int numCards) {
+    for (int i=0; i<numCards; i++) {
+      hand[i] = cards[wrap(head + i)];
+    }
+    head = wrap(head + numCards);
+    count -= numCards;
+  }
+
+  /*appendFrom
+  Purpose: moving every card of another pile to the bottom of this one (e.g. leftover deck cards onto the discard pile), leaving the other pile empty
+  */
+  void appendFrom(BasicCardPile &other) {
+    for (int i=0; i<other.count; i++) {
+      pushBack(other[i]);
+    }
+    other.clear();
+  }
+
+  /*shuffle
+  Purpose: shuffling the pile in place
+  */
+  void shuffle(Rng &rng) {
+    if (head + count > CAPACITY) { //the cards wrap around the end of the buffer; make them contiguous first
+      std::rotate(cards, cards + head, cards + CAPACITY);
+      head = 0;
+    }
+    shuffleInPlace(cards + head, count, rng);
+  }
+
+  void clear() {
+    head = 0;
+    count = 0;
+  }
+
+  /*swap
+  Purpose: exchanging the contents of two piles (e.g. the shuffled discard pile becoming the deck), a fixed-size copy (54 bytes for CardPile)
+  */
+  void swap(BasicCardPile &other) {
+    BasicCardPile temp = *this;
+    *this = other;
+    other = temp;
+  }
+
+private:
+  static int wrap(int index) { return index >= CAPACITY ? index - CAPACITY : index; }
+
+  Card cards[CAPACITY];
+  unsigned char head, count; //index of the top card, number of cards
+};
+
+typedef BasicCardPile<NUM_CARDS> CardPile;
+
+#endif
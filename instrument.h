@@ -0,0 +1,217 @@
+#ifndef WARGAME_INSTRUMENT_H
+#define WARGAME_INSTRUMENT_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+/*INSTRUMENTATION
+Counters and timers on the hot paths (battles, reshuffles, suit tiebreakers, time per game and per order choice), switched on at compile time with -DWARGAME_INSTRUMENT.
+Without it every INSTRUMENT_ macro expands to nothing, so normal builds run exactly the same code as before.
+
+Each thread counts into its own InstrumentBlock (no locks and no shared cache lines on the hot path); the blocks are kept in a lock-free list and added up by instrumentSummary() at the end of a run.
+Histograms have 4 buckets per power of 2 (exact below 8), so percentiles are within 25%.
+*/
+
+#ifdef WARGAME_INSTRUMENT
+const bool INSTRUMENT_ENABLED = true;
+#else
+const bool INSTRUMENT_ENABLED = false;
+#endif
+
+enum InstrumentCounter {
+  INSTRUMENT_GAMES,
+  INSTRUMENT_BATTLES,
+  INSTRUMENT_RESHUFFLES, //"Shuffling discard pile..."
+  INSTRUMENT_SUB_BATTLES,
+  INSTRUMENT_SUIT_TIEBREAKS, //sub-battles between cards of the same face, decided by the suit
+  NUM_INSTRUMENT_COUNTERS
+};
+const char *const INSTRUMENT_COUNTER_NAMES[NUM_INSTRUMENT_COUNTERS] = {"games", "battles", "reshuffles", "sub-battles", "suit tiebreaks"};
+
+enum InstrumentHistogram {
+  INSTRUMENT_BATTLES_PER_GAME,
+  INSTRUMENT_RESHUFFLES_PER_GAME,
+  INSTRUMENT_GAME_NS, //time to play a whole game
+  INSTRUMENT_ORDER_NS, //time for both order choices of a battle in the engine (the two policy calls)
+  INSTRUMENT_BATTLE_NS, //time from the start of a battle to its results in the interactive game, waiting for the players included
+  NUM_INSTRUMENT_HISTOGRAMS
+};
+const char *const INSTRUMENT_HISTOGRAM_NAMES[NUM_INSTRUMENT_HISTOGRAMS] = {"battles per game", "reshuffles per game", "ns per game", "ns per battle's order choices", "ns per interactive battle"};
+
+const int INSTRUMENT_BUCKETS = 256;
+
+/*instrumentBucket
+Purpose: the histogram bucket of a value: the value itself below 8, otherwise 4 buckets per power of 2
+*/
+inline int instrumentBucket(uint64_t value) {
+  if (value < 8) {
+    return value;
+  }
+  int exponent = 63 - __builtin_clzll(value);
+  return 8 + (exponent-3)*4 + ((value >> (exponent-2)) & 3);
+}
+
+/*instrumentBucketStart
+Purpose: the smallest value that falls into a bucket
+*/
+inline uint64_t instrumentBucketStart(int bucket) {
+  if (bucket < 8) {
+    return bucket;
+  }
+  int exponent = (bucket-8) / 4 + 3;
+  return (uint64_t)(4 + (bucket-8) % 4) << (exponent-2);
+}
+
+//One thread's counts; only that thread writes to it, so relaxed loads and stores are enough (no read-modify-write instructions)
+struct InstrumentBlock {
+  std::atomic<uint64_t> counts[NUM_INSTRUMENT_COUNTERS] = {};
+  std::atomic<uint64_t> buckets[NUM_INSTRUMENT_HISTOGRAMS][INSTRUMENT_BUCKETS] = {};
+  std::atomic<uint64_t> sums[NUM_INSTRUMENT_HISTOGRAMS] = {};
+  std::atomic<uint64_t> maximums[NUM_INSTRUMENT_HISTOGRAMS] = {};
+  InstrumentBlock *next = nullptr;
+};
+
+inline std::atomic<InstrumentBlock *> &instrumentBlocks() {
+  static std::atomic<InstrumentBlock *> head(nullptr);
+  return head;
+}
+
+/*localInstrumentBlock
+Purpose: the calling thread's block, created and pushed onto the list on first use (blocks outlive their threads, so counts from finished worker threads are kept)
+*/
+inline InstrumentBlock &localInstrumentBlock() {
+  thread_local InstrumentBlock *block = nullptr;
+  if (block == nullptr) {
+    block = new InstrumentBlock();
+    block->next = instrumentBlocks().load(std::memory_order_relaxed);
+    while (!instrumentBlocks().compare_exchange_weak(block->next, block, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+  }
+  return *block;
+}
+
+inline void instrumentAdd(std::atomic<uint64_t> &count, uint64_t amount) {
+  count.store(count.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+inline void instrumentCount(InstrumentCounter counter, uint64_t amount = 1) {
+  instrumentAdd(localInstrumentBlock().counts[counter], amount);
+}
+
+inline void instrumentValue(InstrumentHistogram histogram, uint64_t value) {
+  InstrumentBlock &block = localInstrumentBlock();
+  instrumentAdd(block.buckets[histogram][instrumentBucket(value)], 1);
+  instrumentAdd(block.sums[histogram], value);
+  if (value > block.maximums[histogram].load(std::memory_order_relaxed)) {
+    block.maximums[histogram].store(value, std::memory_order_relaxed);
+  }
+}
+
+//Records the time from its construction to the end of the scope
+class InstrumentTimer {
+public:
+  explicit InstrumentTimer(InstrumentHistogram timerHistogram) : histogram(timerHistogram), start(std::chrono::steady_clock::now()) {}
+  ~InstrumentTimer() {
+    instrumentValue(histogram, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+  }
+
+private:
+  InstrumentHistogram histogram;
+  std::chrono::steady_clock::time_point start;
+};
+
+#ifdef WARGAME_INSTRUMENT
+#define INSTRUMENT_JOIN2(a, b) a##b
+#define INSTRUMENT_JOIN(a, b) INSTRUMENT_JOIN2(a, b)
+#define INSTRUMENT_COUNT(counter) instrumentCount(counter)
+#define INSTRUMENT_ADD(counter, amount) instrumentCount(counter, amount)
+#define INSTRUMENT_VALUE(histogram, value) instrumentValue(histogram, value)
+#define INSTRUMENT_TIMER(histogram) InstrumentTimer INSTRUMENT_JOIN(instrumentTimer, __LINE__)(histogram)
+#else
+#define INSTRUMENT_COUNT(counter) do {} while (0)
+#define INSTRUMENT_ADD(counter, amount) do {} while (0)
+#define INSTRUMENT_VALUE(histogram, value) do {} while (0)
+#define INSTRUMENT_TIMER(histogram) do {} while (0)
+#endif
+
+/*instrumentSummary
+Purpose: adding up every thread's counts and formatting the totals and histograms (count, mean, percentiles and the non-empty buckets)
+Return: the summary text, or a note that instrumentation is not compiled in
+*/
+inline std::string instrumentSummary() {
+  if (!INSTRUMENT_ENABLED) {
+    return "Instrumentation is off (build with -DWARGAME_INSTRUMENT).\n";
+  }
+  uint64_t counts[NUM_INSTRUMENT_COUNTERS] = {};
+  uint64_t buckets[NUM_INSTRUMENT_HISTOGRAMS][INSTRUMENT_BUCKETS] = {};
+  uint64_t sums[NUM_INSTRUMENT_HISTOGRAMS] = {}, maximums[NUM_INSTRUMENT_HISTOGRAMS] = {};
+  for (InstrumentBlock *block = instrumentBlocks().load(std::memory_order_acquire); block != nullptr; block = block->next) {
+    for (int c=0; c<NUM_INSTRUMENT_COUNTERS; c++) {
+      counts[c] += block->counts[c].load(std::memory_order_relaxed);
+    }
+    for (int h=0; h<NUM_INSTRUMENT_HISTOGRAMS; h++) {
+      for (int b=0; b<INSTRUMENT_BUCKETS; b++) {
+        buckets[h][b] += block->buckets[h][b].load(std::memory_order_relaxed);
+      }
+      sums[h] += block->sums[h].load(std::memory_order_relaxed);
+      uint64_t maximum = block->maximums[h].load(std::memory_order_relaxed);
+      maximums[h] = maximum > maximums[h] ? maximum : maximums[h];
+    }
+  }
+
+  std::string summary = "~ INSTRUMENTATION ~\n";
+  char line[160];
+  for (int c=0; c<NUM_INSTRUMENT_COUNTERS; c++) {
+    std::snprintf(line, sizeof(line), "%-20s %llu\n", INSTRUMENT_COUNTER_NAMES[c], (unsigned long long)counts[c]);
+    summary += line;
+  }
+  if (counts[INSTRUMENT_BATTLES] > 0) {
+    std::snprintf(line, sizeof(line), "reshuffles per battle %.4f, suit tiebreaks per sub-battle %.4f\n", (double)counts[INSTRUMENT_RESHUFFLES] / counts[INSTRUMENT_BATTLES], counts[INSTRUMENT_SUB_BATTLES] ? (double)counts[INSTRUMENT_SUIT_TIEBREAKS] / counts[INSTRUMENT_SUB_BATTLES] : 0.0);
+    summary += line;
+  }
+  for (int h=0; h<NUM_INSTRUMENT_HISTOGRAMS; h++) {
+    uint64_t total = 0;
+    for (int b=0; b<INSTRUMENT_BUCKETS; b++) {
+      total += buckets[h][b];
+    }
+    if (total == 0) {
+      continue;
+    }
+    //Percentiles: the start of the bucket holding that fraction of the values
+    uint64_t percentiles[3];
+    const double FRACTIONS[3] = {0.5, 0.9, 0.99};
+    for (int p=0; p<3; p++) {
+      uint64_t seen = 0;
+      int b = 0;
+      while (b < INSTRUMENT_BUCKETS-1 && (seen += buckets[h][b]) < FRACTIONS[p] * total) {
+        b++;
+      }
+      percentiles[p] = instrumentBucketStart(b);
+    }
+    std::snprintf(line, sizeof(line), "\n%s: count %llu, mean %.1f, p50 %llu, p90 %llu, p99 %llu, max %llu\n", INSTRUMENT_HISTOGRAM_NAMES[h], (unsigned long long)total, (double)sums[h] / total, (unsigned long long)percentiles[0], (unsigned long long)percentiles[1], (unsigned long long)percentiles[2], (unsigned long long)maximums[h]);
+    summary += line;
+    //The buckets themselves, 4 at a time (one line per power of 2)
+    uint64_t rows[INSTRUMENT_BUCKETS] = {};
+    uint64_t tallest = 0;
+    for (int b=0; b<INSTRUMENT_BUCKETS; b++) {
+      int l = b < 8 ? b : 8 + (b-8)/4*4;
+      rows[l] += buckets[h][b];
+      tallest = rows[l] > tallest ? rows[l] : tallest;
+    }
+    for (int l=0; l<INSTRUMENT_BUCKETS; l++) {
+      if (rows[l] == 0) {
+        continue;
+      }
+      std::snprintf(line, sizeof(line), "  >= %-12llu %10llu ", (unsigned long long)instrumentBucketStart(l), (unsigned long long)rows[l]);
+      summary += line;
+      summary += std::string((rows[l] * 40 + tallest - 1) / tallest, '#');
+      summary += "\n";
+    }
+  }
+  return summary;
+}
+
+#endif
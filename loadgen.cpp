@@ -0,0 +1,257 @@
+//Load generator for the game server (wargame --serve): thousands of scripted players on one epoll loop, timing every prompt
+//Build (next to the game): g++ -std=c++17 -O2 loadgen.cpp -o loadgen
+//Usage: loadgen <socket path> [clients] [wars per client] [seed]
+//  Start the server first, e.g. wargame --serve /tmp/wargame.sock 1 --no-color --quiet
+//  First it checks that a game sent as one write (several lines at once) gets every reply
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <poll.h>
+#include "instrument.h"
+#include "random.h"
+#include "server.h"
+using namespace std;
+
+/*SCRIPTED PLAYERS
+Each client plays one whole game with both seats human: it answers every prompt the way a person would (ENTER, name, colour, a random order each battle) and says YES to another war until it has played its wars.
+The prompt is recognised by its text (the last of the known prompts in the reply), so the client follows the game whatever order the prompts come in.
+Latency is the time from sending an answer to receiving the end of the server's reply (PROMPT_END), so it includes the server's work for that answer and both socket hops; it is counted under the prompt that was answered.
+*/
+
+struct Client {
+  int fd = -1;
+  Rng rng;
+  string reply; //text received since the last PROMPT_END
+  chrono::steady_clock::time_point sentAt;
+  bool answered = false; //whether an answer is waiting for its reply (false before the first prompt)
+  int answeredKind = -1; //the kind of prompt that answer was for, which its latency is counted under
+  int warsPlayed = 0;
+  bool sawGoodbye = false;
+};
+
+//The prompts a client answers, recognised by their text
+enum PromptKind { PRESS_ENTER, PLAYER_TYPE, NAME, COLOUR, ORDER, AGAIN, NUM_PROMPT_KINDS };
+const char *const PROMPT_TEXTS[NUM_PROMPT_KINDS] = {"[PRESS ENTER", "Who is playing this seat?", "Please enter your name", "colour from the options", "Enter the order", "another game of War?"};
+const char *const PROMPT_NAMES[NUM_PROMPT_KINDS] = {"press enter", "player type", "name", "colour", "order", "play again"};
+
+struct LatencyHistogram {
+  long long buckets[INSTRUMENT_BUCKETS] = {};
+  long long count = 0;
+  double sum = 0;
+  uint64_t maximum = 0;
+
+  void add(uint64_t ns) {
+    buckets[instrumentBucket(ns)]++;
+    count++;
+    sum += ns;
+    maximum = ns > maximum ? ns : maximum;
+  }
+  //The start of the bucket holding that fraction of the values (within 25%, see instrument.h)
+  uint64_t percentile(double fraction) const {
+    long long seen = 0;
+    int b = 0;
+    while (b < INSTRUMENT_BUCKETS-1 && (seen += buckets[b]) < fraction * count) {
+      b++;
+    }
+    return instrumentBucketStart(b);
+  }
+};
+
+/*answerPrompt
+Purpose: choosing the answer to the prompt at the end of a reply
+Parameters: the client, the reply, the number of wars each client plays, kind that receives the prompt's kind (-1 if not recognised)
+Return: the line to send, without its newline
+*/
+string answerPrompt(Client &client, const string &reply, int wars, int &kind) {
+  kind = -1;
+  size_t last = 0;
+  for (int k=0; k<NUM_PROMPT_KINDS; k++) {
+    size_t position = reply.rfind(PROMPT_TEXTS[k]);
+    if (position != string::npos && (kind == -1 || position > last)) {
+      kind = k;
+      last = position;
+    }
+  }
+  switch (kind) {
+    case PLAYER_TYPE:
+      return "1";
+    case NAME:
+      return "Player " + to_string(client.rng.bounded(1000));
+    case COLOUR:
+      return reply.find("DIFFERENT") != string::npos ? "2" : "1"; //P2 may not take P1's colour
+    case ORDER: {
+      string order = "1234";
+      for (int i=3; i>0; i--) {
+        swap(order[i], order[client.rng.bounded(i+1)]);
+      }
+      return order;
+    }
+    case AGAIN:
+      client.warsPlayed++;
+      return client.warsPlayed < wars ? "YES" : "NO";
+    default: //PRESS_ENTER (the caller gives up on anything unrecognised)
+      return "";
+  }
+}
+
+/*checkPipelined
+Purpose: checking that the server answers every line of a write that holds several (a whole game with both seats played by the computer, sent at once)
+Parameters: the socket path
+Return: whether each line got its reply and the game said goodbye
+*/
+bool checkPipelined(const char *path) {
+  const string script = "\n\n\n\n\n2\n2\nNO\n"; //5 instruction pages, two computer seats, no second war
+  const int expectedPrompts = 8; //the first prompt and one reply per line but the last
+  int fd = connectLocal(path);
+  if (fd == -1) {
+    cout << "Cannot connect to " << path << ": " << strerror(errno) << endl;
+    return false;
+  }
+  bool sent = send(fd, script.data(), script.size(), MSG_NOSIGNAL) == (ssize_t)script.size();
+  string received;
+  char chunk[65536];
+  pollfd waiting = {fd, POLLIN, 0};
+  while (sent && poll(&waiting, 1, 5000) > 0) { //the server has 5 seconds to answer, so a stall fails instead of hanging
+    ssize_t result = recv(fd, chunk, sizeof(chunk), 0);
+    if (result < 0 && (errno == EAGAIN || errno == EINTR)) {
+      continue;
+    }
+    if (result <= 0) {
+      break;
+    }
+    received.append(chunk, result);
+  }
+  close(fd);
+  long long prompts = count(received.begin(), received.end(), PROMPT_END);
+  bool ok = sent && prompts == expectedPrompts && received.find("Goodbye!") != string::npos && received.back() != PROMPT_END;
+  cout << "Several lines in one write: " << (ok ? "ok" : "FAILED") << " (" << prompts << " of " << expectedPrompts << " prompts)" << endl;
+  return ok;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    cout << "Usage: loadgen <socket path> [clients] [wars per client] [seed]" << endl;
+    return 1;
+  }
+  const char *path = argv[1];
+  int numClients = argc > 2 ? atoi(argv[2]) : 1000;
+  int wars = argc > 3 ? atoi(argv[3]) : 1;
+  unsigned long long seed = argc > 4 ? strtoull(argv[4], nullptr, 10) : 1;
+  if (numClients <= 0 || wars <= 0) {
+    cout << "Invalid client or war count." << endl;
+    return 1;
+  }
+  long long fileLimit = raiseFileLimit();
+  if (numClients + 16 > fileLimit) {
+    cout << "Only " << fileLimit << " files can be open; use fewer clients." << endl;
+    return 1;
+  }
+
+  bool pipelined = checkPipelined(path);
+
+  //Connect everyone first, so every client is playing at the same time
+  int epollFd = epoll_create1(EPOLL_CLOEXEC);
+  vector <Client> clients(numClients);
+  auto start = chrono::steady_clock::now();
+  for (int c=0; c<numClients; c++) {
+    clients[c].rng = Rng(seed, c);
+    clients[c].fd = connectLocal(path);
+    if (clients[c].fd == -1) {
+      cout << "Cannot connect to " << path << ": " << strerror(errno) << " (client " << c << ")" << endl;
+      return 1;
+    }
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u32 = c;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, clients[c].fd, &event);
+  }
+  double connectSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  LatencyHistogram all, byKind[NUM_PROMPT_KINDS];
+  long long unexpected = 0, bytesReceived = 0, failures = 0;
+  int playing = numClients;
+  const int MAX_EVENTS = 256;
+  epoll_event events[MAX_EVENTS];
+  char chunk[65536];
+  start = chrono::steady_clock::now();
+  while (playing > 0) {
+    int ready = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+    if (ready < 0 && errno != EINTR) {
+      cout << "epoll_wait failed: " << strerror(errno) << endl;
+      return 1;
+    }
+    for (int e=0; e<ready; e++) {
+      Client &client = clients[events[e].data.u32];
+      ssize_t received = recv(client.fd, chunk, sizeof(chunk), 0);
+      if (received < 0 && (errno == EAGAIN || errno == EINTR)) {
+        continue;
+      }
+      if (received <= 0) { //the server closed the game: it should have said goodbye after the last war
+        client.sawGoodbye = client.reply.find("Goodbye!") != string::npos;
+        failures += !client.sawGoodbye || client.warsPlayed != wars;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, client.fd, nullptr);
+        close(client.fd);
+        playing--;
+        continue;
+      }
+      bytesReceived += received;
+      client.reply.append(chunk, received);
+      if (client.reply.back() != PROMPT_END) { //the rest of the reply is still coming
+        continue;
+      }
+      auto now = chrono::steady_clock::now();
+      int kind;
+      string answer = answerPrompt(client, client.reply, wars, kind) + "\n";
+      if (kind == -1) { //e.g. an error message: this client's script is out of step with the game, so it gives up
+        if (unexpected++ == 0) {
+          cout << "Prompt not recognised: " << client.reply.substr(client.reply.size() > 200 ? client.reply.size()-200 : 0) << endl;
+        }
+        failures++;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, client.fd, nullptr);
+        close(client.fd);
+        playing--;
+        continue;
+      }
+      if (client.answered) {
+        uint64_t ns = chrono::duration_cast<chrono::nanoseconds>(now - client.sentAt).count();
+        all.add(ns);
+        byKind[client.answeredKind].add(ns);
+      }
+      client.reply.clear();
+      client.sentAt = chrono::steady_clock::now();
+      client.answered = true;
+      client.answeredKind = kind;
+      if (send(client.fd, answer.data(), answer.size(), MSG_NOSIGNAL) != (ssize_t)answer.size()) { //one short line always fits in an empty socket buffer
+        cout << "Cannot send to the server: " << strerror(errno) << endl;
+        return 1;
+      }
+    }
+  }
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  cout << fixed << setprecision(3);
+  cout << numClients << " clients connected in " << connectSeconds << " s, played " << wars << (wars == 1 ? " war" : " wars") << " each in " << seconds << " s" << endl;
+  cout << "Prompts answered: " << all.count << " (" << (long long)(all.count / seconds) << " per second), " << bytesReceived / 1024 << " KiB received" << endl;
+  cout << "Games that did not finish properly: " << failures << ", prompts not recognised: " << unexpected << endl;
+  const int COLUMN = 12;
+  cout << endl << left << setw(24) << "Latency per prompt (ms)" << right << setw(COLUMN) << "count" << setw(COLUMN) << "mean" << setw(COLUMN) << "p50";
+  cout << setw(COLUMN) << "p90" << setw(COLUMN) << "p99" << setw(COLUMN) << "max" << endl;
+  auto printRow = [&](const char *name, const LatencyHistogram &histogram) {
+    if (histogram.count == 0) {
+      return;
+    }
+    cout << "  " << left << setw(22) << name << right << setw(COLUMN) << histogram.count << setw(COLUMN) << histogram.sum / histogram.count / 1e6;
+    cout << setw(COLUMN) << histogram.percentile(0.5) / 1e6 << setw(COLUMN) << histogram.percentile(0.9) / 1e6 << setw(COLUMN) << histogram.percentile(0.99) / 1e6 << setw(COLUMN) << histogram.maximum / 1e6 << endl;
+  };
+  printRow("all", all);
+  for (int k=0; k<NUM_PROMPT_KINDS; k++) {
+    printRow(PROMPT_NAMES[k], byKind[k]);
+  }
+  return failures > 0 || unexpected > 0 || !pipelined;
+}
@@ -0,0 +1,54 @@
+#ifndef WARGAME_POLICIES_H
+#define WARGAME_POLICIES_H
+
+#include <cstring>
+#include "simulation.h"
+#include "solver.h"
+#include "tuning.h"
+
+/*POLICY REGISTRY
+Every order-choice policy that can be selected by name (from the command line, or for a computer player).
+*/
+
+struct NamedPolicy {
+  const char *name;
+  OrderPolicy policy;
+};
+
+const NamedPolicy POLICIES[] = {
+  {"fixed", fixedOrder},
+  {"random", randomOrder},
+  {"ascending", ascendingOrder},
+  {"descending", descendingOrder},
+  {"greedy", greedyOrder},
+  {"maximin", maximinPolicy},
+  {"counter", counterGreedyPolicy},
+  {"tuned", tunedOrder}
+};
+const int NUM_POLICIES = sizeof(POLICIES) / sizeof(POLICIES[0]);
+
+/*findPolicyIndex
+Purpose: looking up a policy by its name
+Parameters: name of the policy
+Return: index into POLICIES, or -1 if no policy has that name
+*/
+inline int findPolicyIndex(const char *name) {
+  for (int i=0; i<NUM_POLICIES; i++) {
+    if (std::strcmp(POLICIES[i].name, name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/*findPolicy
+Purpose: looking up a policy by its name
+Parameters: name of the policy
+Return: the policy, or nullptr if no policy has that name
+*/
+inline OrderPolicy findPolicy(const char *name) {
+  int index = findPolicyIndex(name);
+  return index == -1 ? nullptr : POLICIES[index].policy;
+}
+
+#endif
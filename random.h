@@ -0,0 +1,90 @@
+#ifndef WARGAME_RANDOM_H
+#define WARGAME_RANDOM_H
+
+#include <cstdint>
+
+/*RANDOM NUMBER GENERATION
+Rng is a PCG32 generator (64-bit LCG state, permuted 32-bit output): 16 bytes of state, a few cycles per number, and 2^63 independent streams selected by the increment.
+Every game or thread gets its own stream from (master seed, stream id), so a whole simulation run is reproducible bit-for-bit from one seed no matter how games are divided between threads.
+*/
+
+/*splitMix64
+Purpose: scrambling a seed or stream id so that nearby values (0, 1, 2, ...) give unrelated generator states
+*/
+inline uint64_t splitMix64(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+class Rng {
+public:
+  typedef uint32_t result_type;
+
+  /*Rng constructor
+  Parameters: master seed, stream id (e.g. game number or thread number)
+  */
+  explicit Rng(uint64_t seed = 0, uint64_t stream = 0) {
+    state = 0;
+    inc = (splitMix64(stream) << 1) | 1; //the increment must be odd
+    next();
+    state += splitMix64(seed);
+    next();
+  }
+
+  /*next
+  Purpose: generating the next 32 random bits
+  */
+  uint32_t next() {
+    uint64_t oldState = state;
+    state = oldState * 6364136223846793005ULL + inc;
+    uint32_t xorShifted = (uint32_t)(((oldState >> 18) ^ oldState) >> 27);
+    uint32_t rotation = (uint32_t)(oldState >> 59);
+    return (xorShifted >> rotation) | (xorShifted << ((-rotation) & 31));
+  }
+
+  /*bounded
+  Purpose: generating an unbiased random integer in [0, range) with a multiply instead of a division (Lemire's method)
+  Parameters: number of possible values (must be at least 1)
+  */
+  uint32_t bounded(uint32_t range) {
+    uint64_t product = (uint64_t)next() * range;
+    uint32_t low = (uint32_t)product;
+    if (low < range) { //only the rare values in the biased zone need the threshold (and its division)
+      uint32_t threshold = (-range) % range;
+      while (low < threshold) {
+        product = (uint64_t)next() * range;
+        low = (uint32_t)product;
+      }
+    }
+    return (uint32_t)(product >> 32);
+  }
+
+  //Lets Rng be used with the <random> and <algorithm> functions that take a UniformRandomBitGenerator
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return 0xFFFFFFFFu; }
+  result_type operator()() { return next(); }
+
+  //Same state and stream: both will generate the same numbers (e.g. to tell whether something drew from a generator)
+  bool operator==(const Rng &other) const { return state == other.state && inc == other.inc; }
+
+private:
+  uint64_t state, inc;
+};
+
+/*shuffleInPlace
+Purpose: Fisher-Yates shuffle of an array in place (each of the n! orders is equally likely, O(n), no allocation)
+Parameters: pointer to the first element, number of elements, random number generator
+*/
+template <typename T>
+inline void shuffleInPlace(T *items, int count, Rng &rng) {
+  for (int i=count-1; i>0; i--) {
+    int j = rng.bounded(i+1); //pick from the cards not yet placed, including card i itself
+    T temp = items[i];
+    items[i] = items[j];
+    items[j] = temp;
+  }
+}
+
+#endif
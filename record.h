@@ -0,0 +1,465 @@
+#ifndef WARGAME_RECORD_H
+#define WARGAME_RECORD_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "deck.h"
+#include "simulation.h"
+
+/*GAME RECORDS
+A record file stores complete games compactly enough to keep millions of them, and replays them without rerunning any policy.
+
+File layout (integers are little-endian):
+  8-byte magic "WARREC01", then one record per game:
+    u32 payload length in bits
+    u64 seed, u64 stream: Rng(seed, stream) dealt the game (dealGame(), or GameSession::startWar() in the interactive game, see session.h)
+    u32 number of battles
+    u8 winner (1 or 2, 0 if the game was abandoned)
+    payload: a bit stream (least significant bit first), for each battle in order:
+      - for P1 then P2, if that player's deck held fewer than 4 cards: the reshuffled deck, as a Lehmer code
+      - P1's order and P2's order, 5 bits each (index into ORDER_PERMUTATIONS)
+The replayer always knows which cards a reshuffle contains (the leftover deck plus the discard pile), so each card of the new deck is stored as its rank among the cards not yet placed, using just enough bits for the cards left (99 bits for 26 cards instead of 156).
+Records are only appended, so a file can be written while games are being played and copied or concatenated afterwards.
+*/
+
+const char RECORD_MAGIC[8] = {'W', 'A', 'R', 'R', 'E', 'C', '0', '1'};
+const int RECORD_HEADER_BYTES = 4 + 8 + 8 + 4 + 1;
+const int RECORD_ORDER_BITS = 5;
+
+/*bitsFor
+Purpose: the number of bits needed to store a value in [0, count)
+*/
+inline int bitsFor(int count) {
+  int bits = 0;
+  while ((1 << bits) < count) {
+    bits++;
+  }
+  return bits;
+}
+
+//Appends values of a few bits each to a byte buffer
+class BitWriter {
+public:
+  void put(uint32_t value, int width) {
+    pending |= (uint64_t)value << pendingBits;
+    pendingBits += width;
+    totalBits += width;
+    while (pendingBits >= 8) {
+      bytes.push_back((unsigned char)pending);
+      pending >>= 8;
+      pendingBits -= 8;
+    }
+  }
+
+  //Bytes written so far, with the last partial byte padded with zeros
+  std::string finishedBytes() const {
+    std::string result(bytes.begin(), bytes.end());
+    if (pendingBits > 0) {
+      result += (char)pending;
+    }
+    return result;
+  }
+
+  uint32_t bitCount() const { return totalBits; }
+
+  void clear() {
+    bytes.clear();
+    pending = 0;
+    pendingBits = 0;
+    totalBits = 0;
+  }
+
+private:
+  std::vector<unsigned char> bytes;
+  uint64_t pending = 0;
+  int pendingBits = 0;
+  uint32_t totalBits = 0;
+};
+
+//Reads values of up to 8 bits each back from a payload; reading past the end sets overrun and returns 0
+class BitReader {
+public:
+  BitReader(const unsigned char *payload, uint32_t payloadBits) : data(payload), sizeBits(payloadBits), position(0), overrun(false) {}
+
+  uint32_t get(int width) {
+    if (width == 0) {
+      return 0;
+    }
+    if (position + width > sizeBits) {
+      overrun = true;
+      return 0;
+    }
+    uint32_t byte = position >> 3;
+    uint32_t chunk = data[byte];
+    if (((position & 7) + width > 8)) { //the value continues into the next byte
+      chunk |= (uint32_t)data[byte+1] << 8;
+    }
+    position += width;
+    return (chunk >> ((position - width) & 7)) & ((1u << width) - 1);
+  }
+
+  bool atEnd() const { return position == sizeBits; }
+  bool hasOverrun() const { return overrun; }
+
+private:
+  const unsigned char *data;
+  uint32_t sizeBits, position;
+  bool overrun;
+};
+
+/*GameRecorder
+Purpose: the playGame() recorder that encodes a game's payload as it is played (also used by the interactive game)
+*/
+class GameRecorder {
+public:
+  void reshuffled(const CardPile &newDeck) {
+    uint64_t remaining = 0;
+    for (int i=0; i<newDeck.size(); i++) {
+      remaining |= 1ULL << newDeck[i];
+    }
+    for (int i=0; i<newDeck.size(); i++) {
+      Card card = newDeck[i];
+      int rank = __builtin_popcountll(remaining & ((1ULL << card) - 1)); //number of unplaced cards below this one
+      bits.put(rank, bitsFor(newDeck.size() - i));
+      remaining &= ~(1ULL << card);
+    }
+  }
+
+  void ordersChosen(const unsigned char p1_order[SIM_HAND_SIZE], const unsigned char p2_order[SIM_HAND_SIZE]) {
+    bits.put(orderIndex(p1_order), RECORD_ORDER_BITS);
+    bits.put(orderIndex(p2_order), RECORD_ORDER_BITS);
+  }
+
+  void clear() { bits.clear(); }
+
+  BitWriter bits;
+};
+
+/*putLittleEndian
+Purpose: appending an integer to a buffer as little-endian bytes
+*/
+inline void putLittleEndian(std::string &buffer, uint64_t value, int numBytes) {
+  for (int i=0; i<numBytes; i++) {
+    buffer += (char)(value >> (8*i));
+  }
+}
+
+inline uint64_t getLittleEndian(const unsigned char *bytes, int numBytes) {
+  uint64_t value = 0;
+  for (int i=0; i<numBytes; i++) {
+    value |= (uint64_t)bytes[i] << (8*i);
+  }
+  return value;
+}
+
+//Streaming, append-only writer: records are collected in memory and written in large blocks
+class RecordWriter {
+public:
+  static const size_t FLUSH_BYTES = 1 << 20;
+
+  RecordWriter() : fd(-1) {}
+  ~RecordWriter() { close(); }
+
+  /*open
+  Purpose: opening a record file for appending, writing the magic if the file is new
+  Parameters: path of the file
+  Return: true if the file could be opened and is a record file (or empty)
+  */
+  bool open(const char *path) {
+    close();
+    fd = ::open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd == -1) {
+      return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+      close();
+      return false;
+    }
+    if (info.st_size == 0) {
+      buffer.append(RECORD_MAGIC, sizeof(RECORD_MAGIC));
+    }
+    else {
+      char magic[sizeof(RECORD_MAGIC)];
+      if (pread(fd, magic, sizeof(magic), 0) != (ssize_t)sizeof(magic) || std::memcmp(magic, RECORD_MAGIC, sizeof(magic)) != 0) {
+        close();
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /*append
+  Purpose: adding one finished game to the file
+  Parameters: seed and stream of the Rng that dealt the game, the game's result, the recorder that played along with it
+  */
+  void append(uint64_t seed, uint64_t stream, const GameResult &result, const GameRecorder &recorder) {
+    putLittleEndian(buffer, recorder.bits.bitCount(), 4);
+    putLittleEndian(buffer, seed, 8);
+    putLittleEndian(buffer, stream, 8);
+    putLittleEndian(buffer, result.battles, 4);
+    putLittleEndian(buffer, result.winner, 1);
+    buffer += recorder.bits.finishedBytes();
+    if (buffer.size() >= FLUSH_BYTES) {
+      flush();
+    }
+  }
+
+  /*flush
+  Purpose: writing everything appended so far to the file (a write cut short by a signal is retried; what could not be written stays in the buffer for the next flush, and what was written is not written again)
+  Return: false if the write failed (error() says why)
+  */
+  bool flush() {
+    size_t written = 0;
+    while (written < buffer.size()) {
+      ssize_t result = ::write(fd, buffer.data() + written, buffer.size() - written);
+      if (result < 0 && errno == EINTR) {
+        continue;
+      }
+      if (result <= 0) {
+        lastError = result < 0 ? errno : EIO;
+        buffer.erase(0, written);
+        return false;
+      }
+      written += result;
+    }
+    buffer.clear();
+    return true;
+  }
+
+  /*close
+  Purpose: writing what is left and closing the file
+  Return: false if some of what was appended could not be written (error() says why)
+  */
+  bool close() {
+    bool complete = true;
+    if (fd != -1) {
+      complete = flush();
+      ::close(fd);
+      fd = -1;
+    }
+    buffer.clear();
+    return complete;
+  }
+
+  //The errno of the last failed write (0 if none failed)
+  int error() const { return lastError; }
+
+private:
+  int fd;
+  int lastError = 0;
+  std::string buffer;
+};
+
+//One game as stored in a record file (the payload points into the mapped file)
+struct GameRecord {
+  uint64_t seed, stream;
+  uint32_t battles;
+  int winner;
+  const unsigned char *payload;
+  uint32_t payloadBits;
+};
+
+//Read-only view of a whole record file, memory-mapped so replaying needs no copies or read() calls
+class RecordFile {
+public:
+  RecordFile() : data(nullptr), size(0) {}
+  ~RecordFile() {
+    if (data != nullptr) {
+      munmap((void *)data, size);
+    }
+  }
+
+  /*open
+  Purpose: mapping a record file into memory
+  Return: true if the file exists and starts with the record magic
+  */
+  bool open(const char *path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd == -1) {
+      return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(RECORD_MAGIC)) {
+      ::close(fd);
+      return false;
+    }
+    void *mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+      return false;
+    }
+    madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+    data = (const unsigned char *)mapped;
+    size = info.st_size;
+    return std::memcmp(data, RECORD_MAGIC, sizeof(RECORD_MAGIC)) == 0;
+  }
+
+  size_t firstOffset() const { return sizeof(RECORD_MAGIC); }
+  size_t fileSize() const { return size; }
+
+  /*read
+  Purpose: reading the record that starts at offset and moving offset to the next one
+  Return: false at the end of the file, or if the last record was cut short (then truncated is set)
+  */
+  bool read(size_t &offset, GameRecord &record, bool &truncated) const {
+    truncated = false;
+    if (offset >= size) {
+      return false;
+    }
+    if (size - offset < (size_t)RECORD_HEADER_BYTES) {
+      truncated = true;
+      return false;
+    }
+    const unsigned char *header = data + offset;
+    record.payloadBits = getLittleEndian(header, 4);
+    record.seed = getLittleEndian(header + 4, 8);
+    record.stream = getLittleEndian(header + 12, 8);
+    record.battles = getLittleEndian(header + 20, 4);
+    record.winner = header[24];
+    size_t payloadBytes = (record.payloadBits + 7) / 8;
+    if (size - offset - RECORD_HEADER_BYTES < payloadBytes) {
+      truncated = true;
+      return false;
+    }
+    record.payload = header + RECORD_HEADER_BYTES;
+    offset += RECORD_HEADER_BYTES + payloadBytes;
+    return true;
+  }
+
+private:
+  const unsigned char *data;
+  size_t size;
+};
+
+/*REPLAY*/
+
+enum ReplayStatus { REPLAY_OK, REPLAY_TRUNCATED, REPLAY_BAD_ORDER, REPLAY_BAD_RESHUFFLE, REPLAY_WRONG_RESULT };
+const char *const REPLAY_STATUS_NAMES[] = {"valid", "payload too short", "invalid order", "invalid reshuffle", "result does not match"};
+
+//Replay observer that watches nothing; replayGame() can be given one that prints or checks each battle instead
+struct NoReplayObserver {
+  void reshuffled(int, const CardPile &) {}
+  void battle(int, const Card [2][SIM_HAND_SIZE], const unsigned char *, const unsigned char *) {}
+};
+
+/*decodeReshuffle
+Purpose: rebuilding a reshuffled deck from its Lehmer code
+Parameters: the player (the cards of the deck and discard pile are the ones reshuffled), the payload reader
+Return: false if a stored rank does not fit the number of cards left
+*/
+inline bool decodeReshuffle(SimPlayer &player, BitReader &bits) {
+  uint64_t remaining = 0;
+  for (int i=0; i<player.deck.size(); i++) {
+    remaining |= 1ULL << player.deck[i];
+  }
+  for (int i=0; i<player.discard.size(); i++) {
+    remaining |= 1ULL << player.discard[i];
+  }
+  int numCards = player.deck.size() + player.discard.size();
+  Card newDeck[SIM_DECK_SIZE];
+  for (int i=0; i<numCards; i++) {
+    uint32_t rank = bits.get(bitsFor(numCards - i));
+    if (rank >= (uint32_t)(numCards - i)) {
+      return false;
+    }
+    uint64_t candidates = remaining;
+    for (uint32_t skip=0; skip<rank; skip++) {
+      candidates &= candidates - 1; //drop the lowest remaining card
+    }
+    Card card = __builtin_ctzll(candidates);
+    newDeck[i] = card;
+    remaining &= ~(1ULL << card);
+  }
+  player.deck.assign(newDeck, numCards);
+  player.discard.clear();
+  return true;
+}
+
+/*replayGame
+Purpose: re-executing a recorded game from its deal, orders and reshuffles, and checking it ends the way the record says
+Parameters: the record, observer told about every reshuffle and battle
+Return: REPLAY_OK, or what was wrong with the record
+*/
+template <typename Observer>
+inline ReplayStatus replayGame(const GameRecord &record, Observer &observer) {
+  Rng rng(record.seed, record.stream);
+  SimPlayer p1, p2;
+  dealGame(p1, p2, rng);
+  BitReader bits(record.payload, record.payloadBits);
+  SimPlayer *players[2] = {&p1, &p2};
+  int winner = 0;
+  uint32_t battleNum = 0;
+  while (battleNum < record.battles && winner == 0) {
+    battleNum++;
+    for (int p=0; p<2; p++) {
+      if (players[p]->deck.size() < SIM_HAND_SIZE) {
+        if (!decodeReshuffle(*players[p], bits)) {
+          return bits.hasOverrun() ? REPLAY_TRUNCATED : REPLAY_BAD_RESHUFFLE;
+        }
+        observer.reshuffled(p+1, players[p]->deck);
+      }
+    }
+    uint32_t p1_index = bits.get(RECORD_ORDER_BITS);
+    uint32_t p2_index = bits.get(RECORD_ORDER_BITS);
+    if (bits.hasOverrun()) {
+      return REPLAY_TRUNCATED;
+    }
+    if (p1_index >= 24 || p2_index >= 24) {
+      return REPLAY_BAD_ORDER;
+    }
+    Card currentHands[2][SIM_HAND_SIZE];
+    p1.deck.draw(currentHands[0], SIM_HAND_SIZE);
+    p2.deck.draw(currentHands[1], SIM_HAND_SIZE);
+    const unsigned char *p1_order = ORDER_PERMUTATIONS[p1_index];
+    const unsigned char *p2_order = ORDER_PERMUTATIONS[p2_index];
+    observer.battle(battleNum, currentHands, p1_order, p2_order);
+    for (int i=0; i<SIM_HAND_SIZE; i++) {
+      Card p1_card = currentHands[0][p1_order[i]];
+      Card p2_card = currentHands[1][p2_order[i]];
+      SimPlayer &subBattleWinner = p1_card > p2_card ? p1 : p2;
+      subBattleWinner.discard.pushPair(p1_card, p2_card);
+    }
+    if (p1.totalCards() < SIM_HAND_SIZE) {
+      winner = 2;
+    }
+    else if (p2.totalCards() < SIM_HAND_SIZE) {
+      winner = 1;
+    }
+  }
+  if (battleNum != record.battles || winner != record.winner || !bits.atEnd()) {
+    return REPLAY_WRONG_RESULT;
+  }
+  return REPLAY_OK;
+}
+
+inline ReplayStatus replayGame(const GameRecord &record) {
+  NoReplayObserver observer;
+  return replayGame(record, observer);
+}
+
+/*runSimulationRecorded
+Purpose: runSimulation, also appending every game to a record file
+Parameters: number of games, master seed, both players' policies, number of battles after which a game is abandoned, writer for the record file
+Return: aggregate win and game-length statistics
+*/
+inline SimStats runSimulationRecorded(long long games, uint64_t seed, OrderPolicy p1_policy, OrderPolicy p2_policy, int maxBattles, RecordWriter &writer) {
+  SimStats stats;
+  GameRecorder recorder;
+  for (long long i=0; i<games; i++) {
+    Rng rng(seed, i);
+    recorder.clear();
+    GameResult result = playGame(p1_policy, p2_policy, rng, maxBattles, recorder);
+    writer.append(seed, i, result, recorder);
+    stats.record(result);
+  }
+  return stats;
+}
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef WARGAME_RENDERER_H
+#define WARGAME_RENDERER_H
+
+#include <string>
+#include <cerrno>
+#include <cstdio>
+#include <unistd.h>
+
+/*TERMINAL RENDERER
+Collects game output in one buffer and writes it to the terminal with a single write() call when flushed (before waiting for input and once per battle), instead of flushing every line with endl.
+Modes: COLOUR (default), PLAIN (ANSI colour codes are stripped when flushing, for logs and terminals without colour), and OFF (everything is discarded, e.g. for simulations).
+Muting drops output temporarily (used by the quiet mode to skip battle details).
+A renderer with no file descriptor (-1) only collects: its owner takes the output with drainTo() (e.g. the server, which writes it to a non-blocking socket when the socket is ready).
+*/
+class Renderer {
+public:
+  enum Mode { COLOUR, PLAIN, OFF };
+
+  explicit Renderer(int fileDescriptor = STDOUT_FILENO) : fd(fileDescriptor), mode(COLOUR), muted(false) {
+    buffer.reserve(4096);
+  }
+
+  void setMode(Mode newMode) { mode = newMode; }
+  Mode getMode() const { return mode; }
+  void setMuted(bool isMuted) { muted = isMuted; }
+  bool isMuted() const { return muted; }
+
+  Renderer &operator<<(const char *text) {
+    if (!muted && mode != OFF) {
+      buffer += text;
+    }
+    return *this;
+  }
+  Renderer &operator<<(const std::string &text) {
+    if (!muted && mode != OFF) {
+      buffer += text;
+    }
+    return *this;
+  }
+  Renderer &operator<<(char c) {
+    if (!muted && mode != OFF) {
+      buffer += c;
+    }
+    return *this;
+  }
+  Renderer &operator<<(long long number) {
+    if (!muted && mode != OFF) {
+      char digits[24];
+      int length = std::snprintf(digits, sizeof(digits), "%lld", number);
+      buffer.append(digits, length);
+    }
+    return *this;
+  }
+  Renderer &operator<<(int number) { return *this << (long long)number; }
+
+  /*flush
+  Purpose: writing everything collected so far to the terminal in one system call (stripping colour codes in PLAIN mode)
+  */
+  void flush() {
+    if (buffer.empty() || fd < 0) {
+      return;
+    }
+    if (mode == PLAIN) {
+      stripColourCodes();
+    }
+    size_t written = 0;
+    while (written < buffer.size()) {
+      ssize_t result = ::write(fd, buffer.data() + written, buffer.size() - written);
+      if (result < 0 && errno == EINTR) {
+        continue; //interrupted by a signal before anything was written
+      }
+      if (result <= 0) {
+        break; //the terminal is gone; drop the output rather than spin
+      }
+      written += result;
+    }
+    buffer.clear();
+  }
+
+  /*drainTo
+  Purpose: moving everything collected so far to the end of a string instead of writing it (stripping colour codes in PLAIN mode)
+  */
+  void drainTo(std::string &out) {
+    if (mode == PLAIN) {
+      stripColourCodes();
+    }
+    out += buffer;
+    buffer.clear();
+  }
+
+private:
+  /*stripColourCodes
+  Purpose: removing every ANSI escape sequence of the form ESC [ ... m from the buffer
+  */
+  void stripColourCodes() {
+    size_t out = 0;
+    for (size_t i=0; i<buffer.size(); i++) {
+      if (buffer[i] == '\033' && i+1 < buffer.size() && buffer[i+1] == '[') {
+        size_t end = buffer.find('m', i);
+        if (end != std::string::npos) {
+          i = end;
+          continue;
+        }
+      }
+      buffer[out++] = buffer[i];
+    }
+    buffer.resize(out);
+  }
+
+  int fd;
+  Mode mode;
+  bool muted;
+  std::string buffer;
+};
+
+#endif
@@ -0,0 +1,317 @@
+#ifndef WARGAME_SERVER_H
+#define WARGAME_SERVER_H
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "random.h"
+
+/*GAME SERVER
+Hosts any number of interactive games from one thread (wargame --serve): players connect to a local (Unix domain) socket and each connection gets a game of its own.
+Nothing blocks: one epoll loop waits on every socket, and a game only advances when a whole line of input has arrived for it (the game is a state machine that handles one answer and stops at the next prompt, see GameFlow in wargame.cpp).
+
+Protocol: the server sends the game's text exactly as the terminal game prints it, and ends every reply with a 0 byte (PROMPT_END) to say it is waiting for the next line; clients send one line per answer.
+Every line gets exactly one reply, even a line the prompt ignores (e.g. an empty line where a number is expected), so a scripted client can always send one line and wait for one PROMPT_END.
+When the game is over the server sends the goodbye text (with no PROMPT_END) and closes the connection. A client that disconnects abandons its game; wars already finished are in the record file (--record).
+A connection whose output is not being read stops being read from, so a slow client cannot make the server buffer without limit.
+When the server runs out of file descriptors it stops accepting (new players wait in the listen backlog) until a connection closes, instead of waking up for the same waiting connection over and over.
+*/
+
+const char PROMPT_END = '\0';
+const size_t MAX_LINE_BYTES = 4096; //a longer line closes the connection
+const int SERVER_BACKLOG = 4096;
+
+/*raiseFileLimit
+Purpose: raising the limit on open files to the hard limit, so thousands of sockets can be open at once
+Return: the limit now in effect
+*/
+inline long long raiseFileLimit() {
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+    return -1;
+  }
+  if (limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    getrlimit(RLIMIT_NOFILE, &limit);
+  }
+  return limit.rlim_cur;
+}
+
+/*localAddress
+Purpose: filling in the address of a local socket
+Return: false if the path is too long for a socket address
+*/
+inline bool localAddress(const char *path, sockaddr_un &address) {
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (std::strlen(path) >= sizeof(address.sun_path)) {
+    return false;
+  }
+  std::strcpy(address.sun_path, path);
+  return true;
+}
+
+/*listenLocal
+Purpose: creating a non-blocking local socket that accepts connections at a path (replacing any old socket file there)
+Return: the socket's file descriptor, or -1 on error (errno says why)
+*/
+inline int listenLocal(const char *path) {
+  sockaddr_un address;
+  if (!localAddress(path, address)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd == -1) {
+    return -1;
+  }
+  unlink(path);
+  if (bind(fd, (sockaddr *)&address, sizeof(address)) != 0 || listen(fd, SERVER_BACKLOG) != 0) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    return -1;
+  }
+  return fd;
+}
+
+/*connectLocal
+Purpose: connecting to a local socket (e.g. a load generator playing against the server)
+Return: the connected, non-blocking socket, or -1 on error (errno says why)
+*/
+inline int connectLocal(const char *path) {
+  sockaddr_un address;
+  if (!localAddress(path, address)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1) {
+    return -1;
+  }
+  if (connect(fd, (sockaddr *)&address, sizeof(address)) != 0 || fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    return -1;
+  }
+  return fd;
+}
+
+/*sendPending
+Purpose: sending as much of a buffer as the socket takes right now
+Parameters: the socket, the buffer, how much of it has been sent (updated; the buffer is cleared once all of it is sent)
+Return: false if the connection is broken
+*/
+inline bool sendPending(int fd, std::string &out, size_t &sent) {
+  while (sent < out.size()) {
+    ssize_t result = send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+    if (result < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    sent += result;
+  }
+  out.clear();
+  sent = 0;
+  return true;
+}
+
+inline volatile std::sig_atomic_t &serverStopping() {
+  static volatile std::sig_atomic_t stopping = 0;
+  return stopping;
+}
+
+/*serveGames
+Purpose: running the server until it is interrupted (Ctrl+C or SIGTERM)
+Parameters: socket path, seed (connection n plays with a seed from stream n, so a run is repeatable), function called as setup(flow) on every new game before it starts (options such as the colour mode)
+The Flow must have a constructor Flow(seed, fd) (fd -1: the server takes its output from flow.screen with drainTo()), start(), input(line) and finished()
+Return: 0, or 1 if the socket or the epoll instance could not be set up
+*/
+template <typename Flow, typename Setup>
+int serveGames(const char *path, uint64_t seed, Setup setup) {
+  struct Connection {
+    int fd;
+    std::unique_ptr<Flow> flow;
+    std::string in, out; //input not yet handled (partial lines, or lines waiting for the output to be read), output not yet sent
+    size_t sent = 0;
+    uint32_t events = 0; //what epoll is watching for
+  };
+
+  long long fileLimit = raiseFileLimit();
+  int listener = listenLocal(path);
+  if (listener == -1) {
+    std::printf("Cannot listen on %s: %s\n", path, std::strerror(errno));
+    return 1;
+  }
+  int epollFd = epoll_create1(EPOLL_CLOEXEC);
+  epoll_event listenEvent = {};
+  listenEvent.events = EPOLLIN;
+  listenEvent.data.ptr = nullptr; //the only event without a connection
+  if (epollFd == -1 || epoll_ctl(epollFd, EPOLL_CTL_ADD, listener, &listenEvent) != 0) {
+    std::printf("Cannot wait for connections: %s\n", std::strerror(errno));
+    if (epollFd != -1) {
+      close(epollFd);
+    }
+    close(listener);
+    unlink(path);
+    return 1;
+  }
+
+  //Stop cleanly on Ctrl+C so everything recorded is written out (no SA_RESTART, so epoll_wait returns)
+  struct sigaction stop = {};
+  stop.sa_handler = [](int) { serverStopping() = 1; };
+  sigaction(SIGINT, &stop, nullptr);
+  sigaction(SIGTERM, &stop, nullptr);
+  std::printf("Serving games on %s (up to %lld open files)\n", path, fileLimit);
+  std::fflush(stdout);
+
+  long long connectionsAccepted = 0, gamesFinished = 0, linesHandled = 0;
+  int openConnections = 0;
+  //Out of file descriptors: the listener stays readable while players wait in the backlog, so it is taken out of epoll until a descriptor is freed
+  bool acceptPaused = false;
+  long long acceptPauses = 0;
+  auto resumeAccepting = [&]() {
+    if (acceptPaused && epoll_ctl(epollFd, EPOLL_CTL_ADD, listener, &listenEvent) == 0) {
+      acceptPaused = false;
+    }
+  };
+  auto closeConnection = [&](Connection *connection) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, connection->fd, nullptr);
+    close(connection->fd);
+    delete connection;
+    openConnections--;
+    resumeAccepting();
+  };
+  //Sends what it can, then handles the next complete line and sends its reply, for as long as every reply goes out whole (a client may send several lines in one write)
+  //Stops when no complete line is left, the socket is full or the game is over, and updates what epoll watches for
+  //Return: false if the connection was closed
+  auto advance = [&](Connection *connection) {
+    size_t lineEnd;
+    while (true) {
+      if (!sendPending(connection->fd, connection->out, connection->sent)) {
+        closeConnection(connection);
+        return false;
+      }
+      if (!connection->out.empty() || connection->flow->finished() || (lineEnd = connection->in.find('\n')) == std::string::npos) {
+        break;
+      }
+      std::string line = connection->in.substr(0, lineEnd);
+      connection->in.erase(0, lineEnd+1);
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      connection->flow->input(line);
+      linesHandled++;
+      connection->flow->screen.drainTo(connection->out);
+      if (connection->flow->finished()) {
+        gamesFinished++;
+      }
+      else {
+        connection->out += PROMPT_END;
+      }
+    }
+    if (connection->out.empty() && connection->flow->finished()) {
+      closeConnection(connection);
+      return false;
+    }
+    uint32_t events = connection->out.empty() ? EPOLLIN : EPOLLOUT;
+    if (events != connection->events) {
+      epoll_event event = {};
+      event.events = events;
+      event.data.ptr = connection;
+      if (epoll_ctl(epollFd, EPOLL_CTL_MOD, connection->fd, &event) != 0) {
+        closeConnection(connection);
+        return false;
+      }
+      connection->events = events;
+    }
+    return true;
+  };
+
+  const int MAX_EVENTS = 256;
+  epoll_event events[MAX_EVENTS];
+  while (!serverStopping()) {
+    //While paused with no connection to close (the descriptors are used elsewhere), try accepting again every second
+    int ready = epoll_wait(epollFd, events, MAX_EVENTS, acceptPaused && openConnections == 0 ? 1000 : -1);
+    if (ready == 0) {
+      resumeAccepting();
+    }
+    for (int e=0; e<ready; e++) {
+      Connection *connection = (Connection *)events[e].data.ptr;
+      if (connection == nullptr) { //new players
+        int fd;
+        while ((fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+          Rng seeds(seed, connectionsAccepted++);
+          connection = new Connection();
+          connection->fd = fd;
+          connection->flow.reset(new Flow((uint64_t)seeds.next() << 32 | seeds.next(), -1));
+          setup(*connection->flow);
+          connection->flow->start();
+          connection->flow->screen.drainTo(connection->out);
+          connection->out += PROMPT_END;
+          connection->events = EPOLLIN;
+          epoll_event event = {};
+          event.events = EPOLLIN;
+          event.data.ptr = connection;
+          if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            delete connection;
+            continue;
+          }
+          openConnections++;
+          advance(connection);
+        }
+        if (errno == EMFILE || errno == ENFILE) {
+          epoll_ctl(epollFd, EPOLL_CTL_DEL, listener, nullptr);
+          acceptPaused = true;
+          if (acceptPauses++ == 0) { //only the first time, as a server at its limit pauses again after most closes
+            std::printf("Out of file descriptors with %d connections open: not accepting until one closes\n", openConnections);
+            std::fflush(stdout);
+          }
+        }
+        continue;
+      }
+      if (events[e].events & EPOLLIN) {
+        char chunk[4096];
+        ssize_t received = recv(connection->fd, chunk, sizeof(chunk), 0);
+        if (received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR)) { //the player left
+          closeConnection(connection);
+          continue;
+        }
+        if (received > 0) {
+          connection->in.append(chunk, received);
+        }
+        if (connection->in.size() > MAX_LINE_BYTES && connection->in.find('\n') == std::string::npos) {
+          closeConnection(connection);
+          continue;
+        }
+      }
+      else if (events[e].events & (EPOLLERR | EPOLLHUP)) {
+        closeConnection(connection);
+        continue;
+      }
+      advance(connection);
+    }
+  }
+  std::printf("\nServed %lld connections: %lld games finished, %d still open, %lld lines of input handled\n", connectionsAccepted, gamesFinished, openConnections, linesHandled);
+  if (acceptPauses > 0) {
+    std::printf("Stopped accepting %lld times for lack of file descriptors\n", acceptPauses);
+  }
+  close(listener);
+  close(epollFd);
+  unlink(path);
+  return 0;
+}
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef WARGAME_SESSION_H
+#define WARGAME_SESSION_H
+
+#include <cstdint>
+#include <string>
+#include "card.h"
+#include "deck.h"
+#include "instrument.h"
+#include "policies.h"
+#include "random.h"
+#include "record.h"
+#include "simulation.h"
+
+/*GAME SESSION
+One interactive game of War (any number of wars between the same two players) with all of its state: player info and scores, both players' piles, the random number generator, the battle in progress and the current war's record.
+Nothing in a session is shared with other sessions; the only data they all use are immutable tables (FACES/SUITS, POLICIES, ORDER_PERMUTATIONS and the solver tables), so any number of sessions can run in one process, each on one thread at a time, without locks.
+A session does no I/O: the caller shows its state and passes in the players' choices (main() from the terminal; see playComputerWar for a war with no one at the keyboard).
+
+Each war is played as:
+  startWar(), then until warWinner != 0:
+    startBattle() (reshuffles; see reshuffled), drawHands() (see hands), an order for each player (computerOrder() for a computer), finishBattle()
+*/
+
+const int WAR_POINTS = 100; //points for winning a war
+
+//Player info: each seat is played by a human at the keyboard or by the computer, which picks its orders with one of the policies in policies.h
+struct Player {
+  std::string name;
+  int colour = 0; //index into the colour tables, 0 until chosen
+  int score = 0;
+  int policy = -1; //index into POLICIES for a computer player, -1 for a human
+  SimPlayer cards; //deck and discard pile
+
+  bool isComputer() const { return policy != -1; }
+};
+
+struct GameSession {
+  Player players[2]; //P1, P2
+  Rng rng; //every deal seed, reshuffle and computer choice comes from here
+  int warNum = 0, battleNum = 0;
+  int warWinner = 0; //1 or 2 once the current war is over, 0 while it is being played
+
+  //The battle in progress
+  bool reshuffled[2] = {false, false}; //whether each player's discard pile was shuffled in by startBattle()
+  Card hands[2][SIM_HAND_SIZE]; //cards drawn by drawHands(), in drawn order
+  Card played[2][SIM_HAND_SIZE]; //cards in the order they were played, set by finishBattle()
+  int subBattleWinners[SIM_HAND_SIZE]; //1 or 2 for each sub-battle, set by finishBattle()
+
+  //The current war's record (see record.h): each war is dealt from its own seed so a replay can re-deal it
+  RecordWriter *recordWriter = nullptr; //finished wars are appended here if set (a writer must not be shared by sessions on different threads)
+  bool recordFailed = false; //whether the war that just ended could not be written to the record file (it stays in the writer's buffer for the next try)
+  GameRecorder recorder;
+  uint64_t warSeed = 0;
+  int warReshuffles = 0;
+
+  explicit GameSession(uint64_t seed) : rng(seed) {}
+
+  Player &player(int playerNum) { return players[playerNum-1]; }
+  const Player &player(int playerNum) const { return players[playerNum-1]; }
+  bool everyoneComputer() const { return players[0].isComputer() && players[1].isComputer(); }
+
+  /*startWar
+  Purpose: starting a new war: clearing all card piles and dealing 26 cards to each player (the same way as dealGame(), from a seed of the war's own)
+  */
+  void startWar() {
+    warNum++;
+    battleNum = 0;
+    warWinner = 0;
+    recorder.clear();
+    warReshuffles = 0;
+    warSeed = rng.next();
+    Rng dealRng(warSeed);
+    dealGame(players[0].cards, players[1].cards, dealRng);
+  }
+
+  /*startBattle
+  Purpose: starting the next battle: shuffling in the discard pile of each player with fewer than 4 cards in their deck
+  */
+  void startBattle() {
+    battleNum++;
+    for (int p=0; p<2; p++) {
+      reshuffled[p] = players[p].cards.deck.size() < SIM_HAND_SIZE;
+      if (reshuffled[p]) {
+        refillDeck(players[p].cards, rng);
+        recorder.reshuffled(players[p].cards.deck);
+        warReshuffles++;
+      }
+    }
+  }
+
+  /*drawHands
+  Purpose: drawing the top 4 cards from each player's deck into hands
+  */
+  void drawHands() {
+    players[0].cards.deck.draw(hands[0], SIM_HAND_SIZE);
+    players[1].cards.deck.draw(hands[1], SIM_HAND_SIZE);
+  }
+
+  /*computerOrder
+  Purpose: letting a computer player pick its order with its policy, from the same information a human sees on screen (P1 chooses before P2's cards are shown, so only P2 sees the other hand)
+  Parameters: the player number, order that receives the hand indexes
+  */
+  void computerOrder(int playerNum, unsigned char order[SIM_HAND_SIZE]) {
+    const SimPlayer &own = player(playerNum).cards, &opponent = player(3-playerNum).cards;
+    BattleView view = {hands[playerNum-1], playerNum == 2 ? hands[0] : nullptr, own.deck.size(), own.discard.size(), opponent.deck.size(), opponent.discard.size(), battleNum};
+    POLICIES[player(playerNum).policy].policy(view, order, rng);
+  }
+
+  /*finishBattle
+  Purpose: playing the 4 sub-battles in the chosen orders, and ending the war (scoring it and adding it to the instrumentation and the record) if a player has fewer than 4 cards left
+  Parameters: both players' orders (hand indexes)
+  */
+  void finishBattle(const unsigned char p1_order[SIM_HAND_SIZE], const unsigned char p2_order[SIM_HAND_SIZE]) {
+    recorder.ordersChosen(p1_order, p2_order);
+    for (int i=0; i<SIM_HAND_SIZE; i++) {
+      played[0][i] = hands[0][p1_order[i]];
+      played[1][i] = hands[1][p2_order[i]];
+      //Cards are encoded as face*4 + suit, so the larger card has the larger face, or the same face and the larger suit (suit tiebreaker)
+      INSTRUMENT_ADD(INSTRUMENT_SUIT_TIEBREAKS, cardFace(played[0][i]) == cardFace(played[1][i]));
+      subBattleWinners[i] = played[0][i] > played[1][i] ? 1 : 2;
+      player(subBattleWinners[i]).cards.discard.pushPair(played[0][i], played[1][i]); //the winner's discard pile gains both cards
+    }
+    if (players[0].cards.totalCards() < SIM_HAND_SIZE) {
+      endWar(2);
+    }
+    else if (players[1].cards.totalCards() < SIM_HAND_SIZE) {
+      endWar(1);
+    }
+  }
+
+private:
+  /*endWar
+  Purpose: scoring the war that just ended and adding it to the instrumentation and to the record
+  */
+  void endWar(int winner) {
+    warWinner = winner;
+    player(winner).score += WAR_POINTS;
+    GameResult result = {winner, battleNum, warReshuffles};
+    instrumentGame(result);
+    if (recordWriter != nullptr) {
+      recordWriter->append(warSeed, 0, result, recorder);
+      recordFailed = !recordWriter->flush(); //the war is on disk even if the players quit without answering the next prompt
+    }
+  }
+};
+
+/*playComputerWar
+Purpose: playing a whole war between two computer players (e.g. many sessions at once to test a server, or to check that sessions are independent)
+Parameters: session whose players are both computers, number of battles after which the war is abandoned
+Return: the winner, or 0 if the war was abandoned
+*/
+inline int playComputerWar(GameSession &game, int maxBattles = SIM_DEFAULT_MAX_BATTLES) {
+  game.startWar();
+  while (game.warWinner == 0 && game.battleNum < maxBattles) {
+    game.startBattle();
+    game.drawHands();
+    unsigned char p1_order[SIM_HAND_SIZE], p2_order[SIM_HAND_SIZE];
+    game.computerOrder(1, p1_order);
+    game.computerOrder(2, p2_order);
+    game.finishBattle(p1_order, p2_order);
+  }
+  return game.warWinner;
+}
+
+#endif
@@ -0,0 +1,399 @@
+#ifndef WARGAME_SIMULATION_H
+#define WARGAME_SIMULATION_H
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "card.h"
+#include "deck.h"
+#include "instrument.h"
+#include "random.h"
+
+/*HEADLESS SIMULATION ENGINE
+Plays complete games of War with the same rules as main()/battle() (26/26 split of a shuffled deck, 4-card battles, discard pile shuffled in when fewer than 4 cards remain in the deck, a player with fewer than 4 cards in total loses) but without any prompts or output, so that large batches of games can be generated for training and balance data.
+*/
+
+const int SIM_DECK_SIZE = NUM_CARDS;
+const int SIM_HAND_SIZE = 4;
+const int SIM_DEFAULT_MAX_BATTLES = 100000; //games still running after this many battles are recorded as unfinished
+const int SIM_LENGTH_BUCKETS = 4096; //game lengths at or above this are all counted in the last histogram bucket
+
+//All 24 orders of a 4-card hand in increasing order of their 4-digit entry ("1234", "1243", ..., "4321"), 0-indexed
+constexpr unsigned char ORDER_PERMUTATIONS[24][4] = {
+  {0,1,2,3}, {0,1,3,2}, {0,2,1,3}, {0,2,3,1}, {0,3,1,2}, {0,3,2,1},
+  {1,0,2,3}, {1,0,3,2}, {1,2,0,3}, {1,2,3,0}, {1,3,0,2}, {1,3,2,0},
+  {2,0,1,3}, {2,0,3,1}, {2,1,0,3}, {2,1,3,0}, {2,3,0,1}, {2,3,1,0},
+  {3,0,1,2}, {3,0,2,1}, {3,1,0,2}, {3,1,2,0}, {3,2,0,1}, {3,2,1,0}
+};
+
+/*orderIndex
+Purpose: finding an order's position in ORDER_PERMUTATIONS (its Lehmer code)
+Parameters: order of hand indexes
+Return: index from 0-23
+*/
+inline int orderIndex(const unsigned char order[4]) {
+  int index = 0;
+  for (int i=0; i<4; i++) {
+    int smallerLater = 0; //how many of the later entries are smaller, i.e. this entry's rank among the entries not used yet
+    for (int j=i+1; j<4; j++) {
+      smallerLater += order[j] < order[i];
+    }
+    index = index * (4-i) + smallerLater;
+  }
+  return index;
+}
+
+//Everything a player can see on screen when choosing their order in battle(): P1 chooses before P2's cards are shown, so only P2 sees the other hand
+struct BattleView {
+  const Card *hand; //this player's 4 cards
+  const Card *opponentHand; //the other player's 4 cards, or nullptr for P1 (not shown yet)
+  int deckSize, discardSize;
+  int opponentDeckSize, opponentDiscardSize;
+  int battleNum;
+};
+
+//An order-choice policy fills order[i] with the index of the hand card to play in sub-battle i
+typedef void (*OrderPolicy)(const BattleView &view, unsigned char order[SIM_HAND_SIZE], Rng &rng);
+
+/*POLICIES*/
+
+/*fixedOrder
+Purpose: always playing the cards in the order they were drawn (the "1234" entry)
+*/
+inline void fixedOrder(const BattleView &, unsigned char order[SIM_HAND_SIZE], Rng &) {
+  for (int i=0; i<SIM_HAND_SIZE; i++) {
+    order[i] = i;
+  }
+}
+
+/*randomOrder
+Purpose: playing one of the 24 orders chosen uniformly at random
+*/
+inline void randomOrder(const BattleView &, unsigned char order[SIM_HAND_SIZE], Rng &rng) {
+  std::memcpy(order, ORDER_PERMUTATIONS[rng.bounded(24)], SIM_HAND_SIZE);
+}
+
+/*ascendingOrder
+Purpose: playing the weakest card first and the strongest card last
+*/
+inline void ascendingOrder(const BattleView &view, unsigned char order[SIM_HAND_SIZE], Rng &) {
+  for (int i=0; i<SIM_HAND_SIZE; i++) {
+    order[i] = i;
+  }
+  std::sort(order, order+SIM_HAND_SIZE, [&view](unsigned char a, unsigned char b) { return view.hand[a] < view.hand[b]; });
+}
+
+/*descendingOrder
+Purpose: playing the strongest card first and the weakest card last
+*/
+inline void descendingOrder(const BattleView &view, unsigned char order[SIM_HAND_SIZE], Rng &) {
+  for (int i=0; i<SIM_HAND_SIZE; i++) {
+    order[i] = i;
+  }
+  std::sort(order, order+SIM_HAND_SIZE, [&view](unsigned char a, unsigned char b) { return view.hand[a] > view.hand[b]; });
+}
+
+/*greedyOrder
+Purpose: assuming the opponent plays their cards in drawn order, beating each opponent card (weakest first) with the weakest card that still beats it, and throwing the leftover cards against the opponent cards that could not be beaten; this wins as many sub-battles as possible against that opponent
+Without the opponent's hand (as P1) every order wins the same on average, so it plays a random one, which P2 cannot predict from P1's hand
+*/
+inline void greedyOrder(const BattleView &view, unsigned char order[SIM_HAND_SIZE], Rng &rng) {
+  if (view.opponentHand == nullptr) {
+    randomOrder(view, order, rng);
+    return;
+  }
+  //Opponent slots from weakest to strongest card
+  unsigned char slots[SIM_HAND_SIZE] = {0, 1, 2, 3};
+  std::sort(slots, slots+SIM_HAND_SIZE, [&view](unsigned char a, unsigned char b) { return view.opponentHand[a] < view.opponentHand[b]; });
+  bool used[SIM_HAND_SIZE] = {false, false, false, false};
+  bool filled[SIM_HAND_SIZE] = {false, false, false, false};
+  for (int s=0; s<SIM_HAND_SIZE; s++) {
+    int slot = slots[s];
+    int best = -1;
+    for (int j=0; j<SIM_HAND_SIZE; j++) {
+      if (!used[j] && view.hand[j] > view.opponentHand[slot] && (best == -1 || view.hand[j] < view.hand[best])) {
+        best = j;
+      }
+    }
+    if (best != -1) {
+      order[slot] = best;
+      used[best] = true;
+      filled[slot] = true;
+    }
+  }
+  //Cards that cannot win anything go to the remaining slots
+  int next = 0;
+  for (int slot=0; slot<SIM_HAND_SIZE; slot++) {
+    if (!filled[slot]) {
+      while (used[next]) {
+        next++;
+      }
+      order[slot] = next;
+      used[next] = true;
+    }
+  }
+}
+
+/*GAME STATE*/
+
+//One player's cards
+struct SimPlayer {
+  CardPile deck, discard;
+
+  int totalCards() const { return deck.size() + discard.size(); }
+};
+
+struct GameResult {
+  int winner; //1 or 2, or 0 if the game was stopped after maxBattles
+  int battles; //number of battles played, in the same units as battleNum
+  int reshuffles; //number of times either player shuffled their discard pile into their deck
+};
+
+/*instrumentGame
+Purpose: adding a finished game to the instrumentation counters and histograms (nothing without -DWARGAME_INSTRUMENT)
+Parameters: the game's result
+*/
+inline void instrumentGame([[maybe_unused]] const GameResult &result) {
+  INSTRUMENT_COUNT(INSTRUMENT_GAMES);
+  INSTRUMENT_ADD(INSTRUMENT_BATTLES, result.battles);
+  INSTRUMENT_ADD(INSTRUMENT_RESHUFFLES, result.reshuffles);
+  INSTRUMENT_ADD(INSTRUMENT_SUB_BATTLES, result.battles * SIM_HAND_SIZE);
+  INSTRUMENT_VALUE(INSTRUMENT_BATTLES_PER_GAME, result.battles);
+  INSTRUMENT_VALUE(INSTRUMENT_RESHUFFLES_PER_GAME, result.reshuffles);
+}
+
+/*dealGame
+Purpose: shuffling a full deck and splitting it evenly between the 2 players (also how GameSession::startWar() in session.h deals the interactive game)
+Parameters: both players' states, random number generator
+*/
+inline void dealGame(SimPlayer &p1, SimPlayer &p2, Rng &rng) {
+  Card fullDeck[SIM_DECK_SIZE];
+  for (int i=0; i<SIM_DECK_SIZE; i++) {
+    fullDeck[i] = i;
+  }
+  shuffleInPlace(fullDeck, SIM_DECK_SIZE, rng);
+  p1.deck.assign(fullDeck, SIM_DECK_SIZE/2);
+  p2.deck.assign(fullDeck+SIM_DECK_SIZE/2, SIM_DECK_SIZE/2);
+  p1.discard.clear();
+  p2.discard.clear();
+}
+
+/*refillDeck
+Purpose: adding the leftover deck cards to the discard pile and making the shuffled discard pile the new deck (the "Shuffling discard pile..." step of battle())
+Parameters: player whose deck is refilled (a SimPlayer, or a VariantPlayer from variant.h), random number generator
+*/
+template <typename Player>
+inline void refillDeck(Player &player, Rng &rng) {
+  player.discard.appendFrom(player.deck);
+  player.discard.shuffle(rng);
+  player.deck.swap(player.discard); //the deck was emptied above, so the discard pile is now empty
+}
+
+//Recorder for playGame that records nothing (and compiles away); see GameRecorder in record.h for one that does
+struct NoRecorder {
+  void reshuffled(const CardPile &) {}
+  void ordersChosen(const unsigned char [SIM_HAND_SIZE], const unsigned char [SIM_HAND_SIZE]) {}
+};
+
+/*drawBattle
+Purpose: the first half of a battle, up to the cards meeting: reshuffling a deck with fewer than 4 cards, drawing both hands and asking both policies for their orders
+Parameters: both players' states, both players' policies, random number generator, the game's result so far (its battle and reshuffle counts are updated), recorder (see continueGame), played that receives the cards in the order they are played (played[0][k] and played[1][k] meet in sub-battle k)
+*/
+template <typename P1Policy, typename P2Policy, typename Recorder>
+inline void drawBattle(SimPlayer &p1, SimPlayer &p2, const P1Policy &p1_policy, const P2Policy &p2_policy, Rng &rng, GameResult &result, Recorder &recorder, Card played[2][SIM_HAND_SIZE]) {
+  result.battles++;
+  //Shuffle in cards if the deck size is below 4
+  if (p1.deck.size() < SIM_HAND_SIZE) {
+    refillDeck(p1, rng);
+    recorder.reshuffled(p1.deck);
+    result.reshuffles++;
+  }
+  if (p2.deck.size() < SIM_HAND_SIZE) {
+    refillDeck(p2, rng);
+    recorder.reshuffled(p2.deck);
+    result.reshuffles++;
+  }
+  //Draw the top 4 cards from each deck
+  Card currentHands[2][SIM_HAND_SIZE];
+  p1.deck.draw(currentHands[0], SIM_HAND_SIZE);
+  p2.deck.draw(currentHands[1], SIM_HAND_SIZE);
+  //Get the order choices, showing each policy the same information battle() puts on screen (P1 chooses before P2's hand is shown)
+  BattleView p1_view = {currentHands[0], nullptr, p1.deck.size(), p1.discard.size(), p2.deck.size(), p2.discard.size(), result.battles};
+  BattleView p2_view = {currentHands[1], currentHands[0], p2.deck.size(), p2.discard.size(), p1.deck.size(), p1.discard.size(), result.battles};
+  unsigned char p1_order[SIM_HAND_SIZE], p2_order[SIM_HAND_SIZE];
+  {
+    INSTRUMENT_TIMER(INSTRUMENT_ORDER_NS);
+    p1_policy(p1_view, p1_order, rng);
+    p2_policy(p2_view, p2_order, rng);
+  }
+  recorder.ordersChosen(p1_order, p2_order);
+  for (int i=0; i<SIM_HAND_SIZE; i++) {
+    played[0][i] = currentHands[0][p1_order[i]];
+    played[1][i] = currentHands[1][p2_order[i]];
+  }
+}
+
+/*subBattleWinMask
+Purpose: deciding the 4 sub-battles of one battle: the larger card wins (larger face, or the same face with a larger suit)
+Parameters: the cards played (see drawBattle)
+Return: bit k set if P1 wins sub-battle k (compareSubBattles in batch.h decides many battles' masks at once)
+*/
+inline unsigned subBattleWinMask(const Card played[2][SIM_HAND_SIZE]) {
+  unsigned mask = 0;
+  for (int i=0; i<SIM_HAND_SIZE; i++) {
+    mask |= (unsigned)(played[0][i] > played[1][i]) << i;
+  }
+  return mask;
+}
+
+/*settleBattle
+Purpose: the second half of a battle: giving each sub-battle's pair of cards to its winner's discard pile and checking for a loser
+Parameters: both players' states, the cards played (see drawBattle), P1's win mask (see subBattleWinMask), the game's result (its winner is set when a player has fewer than 4 cards in total), tiebreaks that counts sub-battles decided by suit (for the instrumentation)
+Return: whether the game is over
+*/
+inline bool settleBattle(SimPlayer &p1, SimPlayer &p2, const Card played[2][SIM_HAND_SIZE], unsigned p1WinMask, GameResult &result, int &tiebreaks) {
+  for (int i=0; i<SIM_HAND_SIZE; i++) {
+    SimPlayer &winner = (p1WinMask >> i) & 1 ? p1 : p2;
+    winner.discard.pushPair(played[0][i], played[1][i]);
+    tiebreaks += cardFace(played[0][i]) == cardFace(played[1][i]);
+  }
+  //A player with fewer than 4 cards in total loses
+  if (p1.totalCards() < SIM_HAND_SIZE) {
+    result.winner = 2;
+  }
+  else if (p2.totalCards() < SIM_HAND_SIZE) {
+    result.winner = 1;
+  }
+  return result.winner != 0;
+}
+
+/*continueGame
+Purpose: playing a game of War from the given piles until a player has fewer than 4 cards, without any I/O
+Parameters: both players' states (updated as the game is played), both players' policies (an OrderPolicy, or any object called the same way, e.g. a WeightedPolicy from tuning.h), random number generator, number of battles after which the game is abandoned, recorder that is told every reshuffle result (P1 first) and both order choices of each battle
+Return: the winner and the number of battles played from the given piles
+*/
+template <typename P1Policy, typename P2Policy, typename Recorder>
+inline GameResult continueGame(SimPlayer &p1, SimPlayer &p2, const P1Policy &p1_policy, const P2Policy &p2_policy, Rng &rng, int maxBattles, Recorder &recorder) {
+  INSTRUMENT_TIMER(INSTRUMENT_GAME_NS);
+  GameResult result = {0, 0, 0};
+  int tiebreaks = 0; //only used by the instrumentation (optimized away without it)
+  while (result.battles < maxBattles) {
+    Card played[2][SIM_HAND_SIZE];
+    drawBattle(p1, p2, p1_policy, p2_policy, rng, result, recorder, played);
+    if (settleBattle(p1, p2, played, subBattleWinMask(played), result, tiebreaks)) {
+      break;
+    }
+  }
+  INSTRUMENT_ADD(INSTRUMENT_SUIT_TIEBREAKS, tiebreaks);
+  instrumentGame(result);
+  return result;
+}
+
+/*playGame
+Purpose: dealing and playing one complete game of War between two policies without any I/O
+Parameters: both players' policies, random number generator, number of battles after which the game is abandoned, recorder (see continueGame)
+Return: the winner and the length of the game
+*/
+template <typename P1Policy, typename P2Policy, typename Recorder>
+inline GameResult playGame(const P1Policy &p1_policy, const P2Policy &p2_policy, Rng &rng, int maxBattles, Recorder &recorder) {
+  SimPlayer p1, p2;
+  dealGame(p1, p2, rng);
+  return continueGame(p1, p2, p1_policy, p2_policy, rng, maxBattles, recorder);
+}
+
+template <typename P1Policy, typename P2Policy>
+inline GameResult playGame(const P1Policy &p1_policy, const P2Policy &p2_policy, Rng &rng, int maxBattles = SIM_DEFAULT_MAX_BATTLES) {
+  NoRecorder recorder;
+  return playGame(p1_policy, p2_policy, rng, maxBattles, recorder);
+}
+
+/*AGGREGATE STATISTICS*/
+
+struct SimStats {
+  long long games = 0, p1Wins = 0, p2Wins = 0, unfinished = 0;
+  long long totalBattles = 0, totalReshuffles = 0;
+  int minBattles = 0, maxBattles = 0;
+  std::vector<long long> lengthHistogram = std::vector<long long>(SIM_LENGTH_BUCKETS, 0); //lengthHistogram[n] is the number of games that lasted n battles
+
+  /*record
+  Purpose: adding one game's result to the totals
+  */
+  void record(const GameResult &result) {
+    if (games == 0 || result.battles < minBattles) {
+      minBattles = result.battles;
+    }
+    if (result.battles > maxBattles) {
+      maxBattles = result.battles;
+    }
+    games++;
+    if (result.winner == 1) {
+      p1Wins++;
+    }
+    else if (result.winner == 2) {
+      p2Wins++;
+    }
+    else {
+      unfinished++;
+    }
+    totalBattles += result.battles;
+    totalReshuffles += result.reshuffles;
+    lengthHistogram[std::min(result.battles, SIM_LENGTH_BUCKETS-1)]++;
+  }
+
+  /*merge
+  Purpose: adding the totals from another batch of games (e.g. one run on another thread)
+  */
+  void merge(const SimStats &other) {
+    if (other.games == 0) {
+      return;
+    }
+    if (games == 0 || other.minBattles < minBattles) {
+      minBattles = other.minBattles;
+    }
+    maxBattles = std::max(maxBattles, other.maxBattles);
+    games += other.games;
+    p1Wins += other.p1Wins;
+    p2Wins += other.p2Wins;
+    unfinished += other.unfinished;
+    totalBattles += other.totalBattles;
+    totalReshuffles += other.totalReshuffles;
+    for (int i=0; i<SIM_LENGTH_BUCKETS; i++) {
+      lengthHistogram[i] += other.lengthHistogram[i];
+    }
+  }
+
+  double meanBattles() const { return games == 0 ? 0.0 : (double)totalBattles / games; }
+
+  /*percentileBattles
+  Purpose: finding the game length below which the given fraction of games ended
+  Parameters: fraction between 0 and 1 (e.g. 0.5 for the median)
+  Return: game length in battles (lengths past the last histogram bucket are reported as that bucket)
+  */
+  int percentileBattles(double fraction) const {
+    long long target = (long long)(fraction * games);
+    long long seen = 0;
+    for (int i=0; i<SIM_LENGTH_BUCKETS; i++) {
+      seen += lengthHistogram[i];
+      if (seen > target) {
+        return i;
+      }
+    }
+    return SIM_LENGTH_BUCKETS-1;
+  }
+};
+
+/*runSimulation
+Purpose: playing a batch of games between two policies from one seed
+Parameters: number of games, master seed, both players' policies, number of battles after which a game is abandoned, number of the first game (so a run can be split into batches that reproduce the same games)
+Return: aggregate win and game-length statistics
+*/
+inline SimStats runSimulation(long long games, uint64_t seed, OrderPolicy p1_policy, OrderPolicy p2_policy, int maxBattles = SIM_DEFAULT_MAX_BATTLES, long long firstGame = 0) {
+  SimStats stats;
+  for (long long i=firstGame; i<firstGame+games; i++) {
+    Rng rng(seed, i); //game i always uses stream i of the master seed
+    stats.record(playGame(p1_policy, p2_policy, rng, maxBattles));
+  }
+  return stats;
+}
+
+#endif
@@ -0,0 +1,223 @@
+#ifndef WARGAME_SOLVER_H
+#define WARGAME_SOLVER_H
+
+#include <cstring>
+#include "card.h"
+#include "simulation.h"
+
+/*BATTLE-ORDER SOLVER
+In a battle both players pick one of the 24 orders of their 4 cards, and the payoff is the number of sub-battles won.
+Who wins a sub-battle only depends on how the 8 cards rank against each other, and with both hands sorted that is captured by which 4 of the 8 ranks belong to this player: one of C(8,4) = 70 patterns.
+Every 24x24 payoff matrix, best response and minimax order is therefore precomputed per pattern at compile time (SOLVER_TABLES, ~42 KB), and a decision at run time is: sort both hands, find the pattern, read the table.
+
+Minimax: payoff(a, b) only depends on which card meets which, so if either player picks uniformly among the 24 orders, every card meets every opposing card with probability 1/4 whatever the other player does.
+The uniform mix is therefore optimal for both players and the value of the battle is (number of winning card pairs) / 4; the best pure order against an unknown opponent is the maximin order, which guarantees the most sub-battles.
+*/
+
+const int NUM_ORDERS = 24;
+const int NUM_PATTERNS = 70;
+
+struct SolverTables {
+  unsigned char patternIndex[256]; //8-bit pattern (bit k set if the k-th weakest of the 8 cards is ours) -> 0..69, 255 if the mask does not have 4 bits set
+  unsigned char orderIndex[256]; //order packed 2 bits per sub-battle (order[0] in the low bits) -> index into ORDER_PERMUTATIONS
+  unsigned char payoff[NUM_PATTERNS][NUM_ORDERS][NUM_ORDERS]; //sub-battles won playing sorted order a against sorted order b
+  unsigned char bestResponse[NUM_PATTERNS][NUM_ORDERS]; //our sorted order that wins the most sub-battles against sorted order b
+  unsigned char maximinOrder[NUM_PATTERNS]; //our sorted order with the most guaranteed sub-battle wins
+  unsigned char maximinWins[NUM_PATTERNS]; //sub-battles won by maximinOrder against the opponent's best reply
+  unsigned char winningPairs[NUM_PATTERNS]; //number of (our card, their card) pairs we win; the minimax value is winningPairs/4
+
+  //In "sorted order" terms, order[k] is the rank (0 = weakest) of the card played in sub-battle k
+  constexpr SolverTables() : patternIndex(), orderIndex(), payoff(), bestResponse(), maximinOrder(), maximinWins(), winningPairs() {
+    for (int p=0; p<NUM_ORDERS; p++) {
+      int packed = 0;
+      for (int k=0; k<4; k++) {
+        packed |= ORDER_PERMUTATIONS[p][k] << (2*k);
+      }
+      orderIndex[packed] = p;
+    }
+    int numPatterns = 0;
+    for (int mask=0; mask<256; mask++) {
+      patternIndex[mask] = 255;
+      int bits = 0;
+      for (int k=0; k<8; k++) {
+        bits += (mask >> k) & 1;
+      }
+      if (bits != 4) {
+        continue;
+      }
+      int pattern = numPatterns++;
+      patternIndex[mask] = pattern;
+      //beats[i][j]: our i-th weakest card beats their j-th weakest card, i.e. more than j of their cards rank below it
+      bool beats[4][4] = {};
+      int ours = 0, theirsBelow = 0, pairs = 0;
+      for (int k=0; k<8; k++) {
+        if ((mask >> k) & 1) {
+          for (int j=0; j<4; j++) {
+            beats[ours][j] = theirsBelow > j;
+            pairs += theirsBelow > j;
+          }
+          ours++;
+        }
+        else {
+          theirsBelow++;
+        }
+      }
+      winningPairs[pattern] = pairs;
+      int bestGuarantee = -1;
+      for (int a=0; a<NUM_ORDERS; a++) {
+        int worst = 4;
+        for (int b=0; b<NUM_ORDERS; b++) {
+          int wins = 0;
+          for (int k=0; k<4; k++) {
+            wins += beats[ORDER_PERMUTATIONS[a][k]][ORDER_PERMUTATIONS[b][k]];
+          }
+          payoff[pattern][a][b] = wins;
+          worst = wins < worst ? wins : worst;
+        }
+        if (worst > bestGuarantee) {
+          bestGuarantee = worst;
+          maximinOrder[pattern] = a;
+          maximinWins[pattern] = worst;
+        }
+      }
+      for (int b=0; b<NUM_ORDERS; b++) {
+        int best = 0;
+        for (int a=1; a<NUM_ORDERS; a++) {
+          if (payoff[pattern][a][b] > payoff[pattern][best][b]) {
+            best = a;
+          }
+        }
+        bestResponse[pattern][b] = best;
+      }
+    }
+  }
+};
+
+constexpr SolverTables SOLVER_TABLES = SolverTables();
+
+//A hand seen through the tables: the pattern of both hands and each hand's cards from weakest to strongest
+struct Matchup {
+  int pattern;
+  unsigned char ourRanked[4], theirRanked[4]; //ourRanked[r] is the hand index of our card with rank r
+  unsigned char theirRank[4]; //theirRank[i] is the rank of their hand card i
+};
+
+/*rankHand
+Purpose: sorting a 4-card hand's indexes from weakest to strongest card
+*/
+inline void rankHand(const Card hand[4], unsigned char ranked[4]) {
+  for (int i=0; i<4; i++) {
+    int rank = 0;
+    for (int j=0; j<4; j++) {
+      rank += hand[j] < hand[i]; //cards are distinct, so every card gets a different rank
+    }
+    ranked[rank] = i;
+  }
+}
+
+/*findMatchup
+Purpose: ranking both hands and finding their entry in SOLVER_TABLES
+Parameters: our hand, their hand
+*/
+inline Matchup findMatchup(const Card hand[4], const Card opponentHand[4]) {
+  Matchup matchup;
+  rankHand(hand, matchup.ourRanked);
+  rankHand(opponentHand, matchup.theirRanked);
+  for (int r=0; r<4; r++) {
+    matchup.theirRank[matchup.theirRanked[r]] = r;
+  }
+  int mask = 0;
+  for (int r=0; r<4; r++) {
+    int below = 0;
+    for (int j=0; j<4; j++) {
+      below += opponentHand[j] < hand[matchup.ourRanked[r]];
+    }
+    mask |= 1 << (r + below); //our rank-r card is the (r+below)-th weakest of the 8
+  }
+  matchup.pattern = SOLVER_TABLES.patternIndex[mask];
+  return matchup;
+}
+
+/*toHandOrder
+Purpose: turning an order from the tables (ranks) into an order of hand indexes, the form used by OrderPolicy
+*/
+inline void toHandOrder(const Matchup &matchup, int sortedOrder, unsigned char order[4]) {
+  for (int k=0; k<4; k++) {
+    order[k] = matchup.ourRanked[ORDER_PERMUTATIONS[sortedOrder][k]];
+  }
+}
+
+/*bestResponse
+Purpose: finding the order that wins the most sub-battles against a known opponent order
+Parameters: our hand, their hand, their order (hand indexes), array that receives our order (hand indexes)
+Return: number of sub-battles our order wins
+*/
+inline int bestResponse(const Card hand[4], const Card opponentHand[4], const unsigned char opponentOrder[4], unsigned char order[4]) {
+  Matchup matchup = findMatchup(hand, opponentHand);
+  int packed = 0;
+  for (int k=0; k<4; k++) {
+    packed |= matchup.theirRank[opponentOrder[k]] << (2*k);
+  }
+  int theirs = SOLVER_TABLES.orderIndex[packed];
+  int ours = SOLVER_TABLES.bestResponse[matchup.pattern][theirs];
+  toHandOrder(matchup, ours, order);
+  return SOLVER_TABLES.payoff[matchup.pattern][ours][theirs];
+}
+
+/*maximinOrder
+Purpose: finding the pure order that guarantees the most sub-battle wins whatever order the opponent picks
+Parameters: our hand, their hand, array that receives our order (hand indexes)
+Return: number of sub-battles guaranteed
+*/
+inline int maximinOrder(const Card hand[4], const Card opponentHand[4], unsigned char order[4]) {
+  Matchup matchup = findMatchup(hand, opponentHand);
+  toHandOrder(matchup, SOLVER_TABLES.maximinOrder[matchup.pattern], order);
+  return SOLVER_TABLES.maximinWins[matchup.pattern];
+}
+
+/*minimaxValue
+Purpose: the expected number of sub-battles won when both players play their minimax (uniformly random) strategy
+*/
+inline double minimaxValue(const Card hand[4], const Card opponentHand[4]) {
+  return SOLVER_TABLES.winningPairs[findMatchup(hand, opponentHand).pattern] / 4.0;
+}
+
+/*payoffMatrix
+Purpose: building the full 24x24 payoff matrix for two hands in ORDER_PERMUTATIONS order (rows: our order, columns: their order)
+Parameters: our hand, their hand, matrix that receives the number of sub-battles we win
+*/
+inline void payoffMatrix(const Card hand[4], const Card opponentHand[4], unsigned char payoff[NUM_ORDERS][NUM_ORDERS]) {
+  for (int a=0; a<NUM_ORDERS; a++) {
+    for (int b=0; b<NUM_ORDERS; b++) {
+      int wins = 0;
+      for (int k=0; k<4; k++) {
+        wins += hand[ORDER_PERMUTATIONS[a][k]] > opponentHand[ORDER_PERMUTATIONS[b][k]];
+      }
+      payoff[a][b] = wins;
+    }
+  }
+}
+
+/*SOLVER POLICIES*/
+
+/*maximinPolicy
+Purpose: playing the order with the most guaranteed sub-battle wins (a computer opponent that cannot be exploited by a clever order)
+Without the opponent's hand (as P1) no order guarantees more than another, so it plays a random one: the only choice P2 cannot exploit after seeing P1's hand
+*/
+inline void maximinPolicy(const BattleView &view, unsigned char order[SIM_HAND_SIZE], Rng &rng) {
+  if (view.opponentHand == nullptr) {
+    randomOrder(view, order, rng);
+    return;
+  }
+  maximinOrder(view.hand, view.opponentHand, order);
+}
+
+/*counterGreedyPolicy
+Purpose: predicting that the opponent plays greedyOrder and playing the best response to it
+As P1 there is no hand to respond to, so it plays a random order (see maximinPolicy); as P2 the prediction is greedyOrder from P1's side, which did not see P2's hand and so played a random order that no reply beats on average, so it plays the maximin order instead
+*/
+inline void counterGreedyPolicy(const BattleView &view, unsigned char order[SIM_HAND_SIZE], Rng &rng) {
+  maximinPolicy(view, order, rng);
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef WARGAME_TOURNAMENT_H
+#define WARGAME_TOURNAMENT_H
+
+#include <vector>
+#include "policies.h"
+#include "simulation.h"
+#include "workpool.h"
+
+/*MONTE CARLO TOURNAMENT
+Plays every ordered pairing (P1 policy, P2 policy) of a list of policies for a fixed number of games, spread over all cores with WorkStealingPool.
+Game i of every pairing is played on stream i of the master seed, so all pairings start from the same deals (common random numbers) and the results do not depend on the number of threads.
+Each worker adds its games to its own SimStats per pairing; these are merged once at the end.
+*/
+
+const long long TOURNAMENT_CHUNK = 4096; //games per task
+const int TOURNAMENT_MAX_BATTLES = 10000; //some pairings (e.g. ascending vs descending) stall for a long time, so tournaments abandon games sooner than single runs
+
+struct TournamentResult {
+  std::vector<int> policies; //indexes into POLICIES
+  std::vector<SimStats> pairings; //pairings[p1*policies.size() + p2] holds the games with policies[p1] as P1 and policies[p2] as P2
+
+  const SimStats &pairing(int p1, int p2) const { return pairings[p1*policies.size() + p2]; }
+};
+
+/*runTournament
+Purpose: playing every pairing of the given policies in parallel
+Parameters: indexes of the policies in POLICIES, games per pairing, master seed, number of worker threads, number of battles after which a game is abandoned
+Return: statistics for every pairing
+*/
+inline TournamentResult runTournament(const std::vector<int> &policies, long long gamesPerPairing, uint64_t seed, int numThreads, int maxBattles = TOURNAMENT_MAX_BATTLES) {
+  int numPolicies = policies.size();
+  int numPairings = numPolicies * numPolicies;
+  long long chunksPerPairing = (gamesPerPairing + TOURNAMENT_CHUNK - 1) / TOURNAMENT_CHUNK;
+
+  WorkStealingPool pool(numThreads);
+  std::vector< std::vector<SimStats> > workerStats(pool.threadCount(), std::vector<SimStats>(numPairings));
+  pool.run(numPairings * chunksPerPairing, [&](long long task, int worker) {
+    int pairing = task / chunksPerPairing;
+    long long firstGame = (task % chunksPerPairing) * TOURNAMENT_CHUNK;
+    long long games = std::min(TOURNAMENT_CHUNK, gamesPerPairing - firstGame);
+    OrderPolicy p1_policy = POLICIES[policies[pairing / numPolicies]].policy;
+    OrderPolicy p2_policy = POLICIES[policies[pairing % numPolicies]].policy;
+    workerStats[worker][pairing].merge(runSimulation(games, seed, p1_policy, p2_policy, maxBattles, firstGame));
+  });
+
+  TournamentResult result;
+  result.policies = policies;
+  result.pairings.resize(numPairings);
+  for (const std::vector<SimStats> &stats : workerStats) {
+    for (int p=0; p<numPairings; p++) {
+      result.pairings[p].merge(stats[p]);
+    }
+  }
+  return result;
+}
+
+#endif
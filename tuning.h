@@ -0,0 +1,422 @@
+#ifndef WARGAME_TUNING_H
+#define WARGAME_TUNING_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "simulation.h"
+#include "workpool.h"
+
+/*STRATEGY TUNING
+A policy whose behaviour is set by a list of weights (WeightedPolicy), and a cross-entropy search for the weights that win the most against a set of opponents, using the headless engine as the fitness function.
+
+The policy scores every one of the 24 orders and plays the best: an order's score is the sum over its 4 sub-battles of the weighted features below, which only use what the player is shown (BattleView: their own hand and the pile sizes, and P1's hand when playing P2).
+The opponent's order is not known, so the "wins" features count the sub-battles won against the orders that simple opponents would play from P1's seat without seeing our hand: the drawn order, ascending and descending. They need P1's hand, so they only count when the policy plays P2; as P1 the order only depends on the rank features.
+
+The search keeps a Gaussian over the weights (a mean and a spread for each). Each generation samples candidates from it, plays every candidate against every opponent on the same deals, in both seats (common random numbers: only the candidates differ, so their win rates are compared on equal terms), and moves the Gaussian towards the best candidates (the elite).
+Every generation is played on deals of its own, so the search cannot overfit one set of deals; the final weights are then measured on deals the search never saw.
+Games are spread over all cores with WorkStealingPool and the wins are counted in whole games, so the search is the same for any number of threads, and the state after each generation can be saved and resumed exactly.
+*/
+
+enum PolicyFeature {
+  WINS_VS_DRAWN, //sub-battles won if the opponent plays their cards in drawn order
+  WINS_VS_ASCENDING,
+  WINS_VS_DESCENDING,
+  RANK_IN_SLOT_1, //how strong the card played in sub-battle 1 is within our hand (0 for the weakest, 1 for the strongest)
+  RANK_IN_SLOT_2,
+  RANK_IN_SLOT_3,
+  RANK_IN_SLOT_4,
+  LEAD_WINS_VS_DRAWN, //WINS_VS_DRAWN times our lead in cards (our cards minus theirs, over 52), so the policy can play differently when ahead or behind
+  NUM_POLICY_FEATURES
+};
+const char *const POLICY_FEATURE_NAMES[NUM_POLICY_FEATURES] = {"wins vs drawn", "wins vs ascending", "wins vs descending", "rank in slot 1", "rank in slot 2", "rank in slot 3", "rank in slot 4", "lead x wins vs drawn"};
+
+struct PolicyWeights {
+  double weights[NUM_POLICY_FEATURES] = {};
+
+  double &operator[](int feature) { return weights[feature]; }
+  double operator[](int feature) const { return weights[feature]; }
+};
+
+//Weights found by wargame --tune 25 1000 1 random greedy counter descending, used by the "tuned" policy
+//On 20000 new deals per opponent (both seats) it wins 59.3% +/- 0.2% over the four opponents, 12.6 +/- 0.2 points more than counter: all of it against descending (87.8%), level with counter against the others
+const PolicyWeights TUNED_WEIGHTS = {{0.1635, 0.1790, 1.4627, -1.3111, -0.3112, 1.0359, 0.0649, -1.0473}};
+
+/*weightedOrder
+Purpose: playing the order with the highest weighted score
+Parameters: what the player sees, the weights, order that receives the hand indexes, random number generator (passed to the predicted opponents, which do not use it)
+*/
+inline void weightedOrder(const BattleView &view, const PolicyWeights &weights, unsigned char order[SIM_HAND_SIZE], Rng &rng) {
+  //The orders the opponent is predicted to play, seen from P1's side of the table (only when their hand is shown, i.e. as P2; P1 does not see ours)
+  const int NUM_PREDICTED = 3;
+  bool opponentShown = view.opponentHand != nullptr;
+  unsigned char predicted[NUM_PREDICTED][SIM_HAND_SIZE];
+  if (opponentShown) {
+    BattleView opponentView = {view.opponentHand, nullptr, view.opponentDeckSize, view.opponentDiscardSize, view.deckSize, view.discardSize, view.battleNum};
+    fixedOrder(opponentView, predicted[0], rng);
+    ascendingOrder(opponentView, predicted[1], rng);
+    descendingOrder(opponentView, predicted[2], rng);
+  }
+  double lead = (double)(view.deckSize + view.discardSize - view.opponentDeckSize - view.opponentDiscardSize) / SIM_DECK_SIZE;
+  double winWeights[NUM_PREDICTED] = {weights[WINS_VS_DRAWN] + lead * weights[LEAD_WINS_VS_DRAWN], weights[WINS_VS_ASCENDING], weights[WINS_VS_DESCENDING]};
+
+  //value[card][slot]: the score of playing that card in that sub-battle
+  double value[SIM_HAND_SIZE][SIM_HAND_SIZE];
+  for (int card=0; card<SIM_HAND_SIZE; card++) {
+    int rank = 0;
+    for (int other=0; other<SIM_HAND_SIZE; other++) {
+      rank += view.hand[other] < view.hand[card];
+    }
+    for (int slot=0; slot<SIM_HAND_SIZE; slot++) {
+      value[card][slot] = weights[RANK_IN_SLOT_1 + slot] * rank / (SIM_HAND_SIZE-1);
+      for (int p=0; p<NUM_PREDICTED && opponentShown; p++) {
+        if (view.hand[card] > view.opponentHand[predicted[p][slot]]) {
+          value[card][slot] += winWeights[p];
+        }
+      }
+    }
+  }
+  int best = 0;
+  double bestScore = 0;
+  for (int o=0; o<24; o++) {
+    const unsigned char *candidate = ORDER_PERMUTATIONS[o];
+    double score = value[candidate[0]][0] + value[candidate[1]][1] + value[candidate[2]][2] + value[candidate[3]][3];
+    if (o == 0 || score > bestScore) { //ties go to the earliest order, so all-zero weights play the drawn order
+      best = o;
+      bestScore = score;
+    }
+  }
+  std::memcpy(order, ORDER_PERMUTATIONS[best], SIM_HAND_SIZE);
+}
+
+//A policy with weights of its own, for the engine's templated playGame()/continueGame()
+struct WeightedPolicy {
+  PolicyWeights weights;
+
+  void operator()(const BattleView &view, unsigned char order[SIM_HAND_SIZE], Rng &rng) const {
+    weightedOrder(view, weights, order, rng);
+  }
+};
+
+/*tunedOrder
+Purpose: the weighted policy with TUNED_WEIGHTS, as a plain OrderPolicy for the registry in policies.h
+*/
+inline void tunedOrder(const BattleView &view, unsigned char order[SIM_HAND_SIZE], Rng &rng) {
+  weightedOrder(view, TUNED_WEIGHTS, order, rng);
+}
+
+/*MEAN ESTIMATES*/
+
+//Running mean and variance of a sample, with a 95% confidence interval for the mean (normal approximation, fine for the thousands of deals used here)
+struct MeanEstimate {
+  long long count = 0;
+  double sum = 0, sumSquares = 0;
+
+  void add(double value) {
+    count++;
+    sum += value;
+    sumSquares += value * value;
+  }
+  void merge(const MeanEstimate &other) {
+    count += other.count;
+    sum += other.sum;
+    sumSquares += other.sumSquares;
+  }
+  double mean() const { return count == 0 ? 0.0 : sum / count; }
+  double halfWidth() const {
+    if (count < 2) {
+      return 0;
+    }
+    double variance = std::max(0.0, (sumSquares - sum * sum / count) / (count - 1));
+    return 1.96 * std::sqrt(variance / count);
+  }
+};
+
+/*CROSS-ENTROPY SEARCH*/
+
+const long long TUNING_CHUNK = 256; //deals per task
+const int TUNING_MAX_BATTLES = 10000; //as in tournaments: a stalled game is abandoned and counts as a loss for both seats
+const uint64_t TUNING_VALIDATION_STREAMS = 1ULL << 48; //validation deals are taken from here up, far past any deal a search plays
+
+struct TuningOptions {
+  std::vector<OrderPolicy> opponents;
+  std::vector<std::string> opponentNames; //saved in the checkpoint, so a search is only resumed against the same opponents
+  int generations = 20;
+  long long dealsPerCandidate = 2000; //per opponent; each deal is played twice, once in each seat
+  int population = 32; //candidates per generation, including the current mean
+  int eliteCount = 6;
+  double smoothing = 0.7; //how far the Gaussian moves towards the elite each generation
+  double minSpread = 0.05; //the spread never shrinks below this, so the search keeps exploring
+  double initialSpread = 1.0;
+  uint64_t seed = 1;
+  int numThreads = 1;
+  std::string checkpointPath; //saved after every generation and resumed from if it exists (empty: no checkpoint)
+};
+
+struct TuningState {
+  int generation = 0; //generations finished
+  PolicyWeights mean, spread;
+  PolicyWeights best; //the candidate with the highest win rate in any generation
+  double bestWinRate = -1;
+  int bestGeneration = -1;
+  long long gamesPlayed = 0;
+};
+
+/*gaussian
+Purpose: a standard normal random number (Box-Muller), the same on every platform (unlike std::normal_distribution)
+*/
+inline double gaussian(Rng &rng) {
+  double u1 = (rng.next() + 1.0) / 4294967297.0; //in (0, 1), so the log is finite
+  double u2 = rng.next() / 4294967296.0;
+  return std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+}
+
+/*playDealBothSeats
+Purpose: playing one deal twice, with the policy as P1 and then as P2 against the opponent (the same shuffles in both games)
+Parameters: the policy, the opponent, master seed, stream of the deal
+Return: the policy's score for the deal: 0, 0.5 or 1 (the fraction of the two games it won)
+*/
+template <typename Policy>
+inline double playDealBothSeats(const Policy &policy, OrderPolicy opponent, uint64_t seed, uint64_t stream) {
+  Rng firstRng(seed, stream), secondRng(seed, stream);
+  int wins = (playGame(policy, opponent, firstRng, TUNING_MAX_BATTLES).winner == 1) + (playGame(opponent, policy, secondRng, TUNING_MAX_BATTLES).winner == 2);
+  return wins * 0.5;
+}
+
+/*evaluateCandidates
+Purpose: playing every candidate against every opponent on the same deals, in parallel
+Parameters: the candidates, options (opponents, deals, seed, threads), stream of the first deal
+Return: each candidate's win rate over all its games
+*/
+inline std::vector<double> evaluateCandidates(const std::vector<PolicyWeights> &candidates, const TuningOptions &options, uint64_t firstStream) {
+  int numCandidates = candidates.size(), numOpponents = options.opponents.size();
+  long long chunks = (options.dealsPerCandidate + TUNING_CHUNK - 1) / TUNING_CHUNK;
+  WorkStealingPool pool(options.numThreads);
+  std::vector< std::vector<long long> > workerWins(pool.threadCount(), std::vector<long long>(numCandidates, 0)); //games won, so the totals do not depend on how the deals were split
+  pool.run((long long)numCandidates * numOpponents * chunks, [&](long long task, int worker) {
+    int candidate = task / (numOpponents * chunks);
+    int opponent = task / chunks % numOpponents;
+    long long firstDeal = task % chunks * TUNING_CHUNK;
+    long long lastDeal = std::min(firstDeal + TUNING_CHUNK, options.dealsPerCandidate);
+    WeightedPolicy policy = {candidates[candidate]};
+    long long wins = 0;
+    for (long long deal=firstDeal; deal<lastDeal; deal++) {
+      wins += (long long)(2 * playDealBothSeats(policy, options.opponents[opponent], options.seed, firstStream + deal));
+    }
+    workerWins[worker][candidate] += wins;
+  });
+  std::vector<double> winRates(numCandidates, 0);
+  for (int c=0; c<numCandidates; c++) {
+    long long wins = 0;
+    for (const std::vector<long long> &counts : workerWins) {
+      wins += counts[c];
+    }
+    winRates[c] = (double)wins / (2 * options.dealsPerCandidate * numOpponents);
+  }
+  return winRates;
+}
+
+/*startTuning
+Purpose: the state before the first generation: the Gaussian starts at all-zero weights (the drawn order) with the initial spread
+*/
+inline TuningState startTuning(const TuningOptions &options) {
+  TuningState state;
+  for (int f=0; f<NUM_POLICY_FEATURES; f++) {
+    state.spread[f] = options.initialSpread;
+  }
+  return state;
+}
+
+/*tuningGeneration
+Purpose: running one generation of the search: sampling the candidates, playing them, and moving the Gaussian towards the elite
+Parameters: options, state (updated)
+Return: the win rates of the generation's candidates (the first candidate is the mean itself)
+*/
+inline std::vector<double> tuningGeneration(const TuningOptions &options, TuningState &state) {
+  //Candidates come from a stream of their own for each generation, so a resumed search samples the same ones
+  Rng sampler(~options.seed, state.generation);
+  std::vector<PolicyWeights> candidates(options.population);
+  candidates[0] = state.mean;
+  for (int c=1; c<options.population; c++) {
+    for (int f=0; f<NUM_POLICY_FEATURES; f++) {
+      candidates[c][f] = state.mean[f] + state.spread[f] * gaussian(sampler);
+    }
+  }
+  //Every candidate of this generation plays the same deals, which no other generation plays
+  uint64_t firstStream = (uint64_t)state.generation * options.dealsPerCandidate;
+  std::vector<double> winRates = evaluateCandidates(candidates, options, firstStream);
+  state.gamesPlayed += 2 * options.dealsPerCandidate * options.opponents.size() * options.population;
+
+  std::vector<int> ranking(options.population);
+  for (int c=0; c<options.population; c++) {
+    ranking[c] = c;
+  }
+  std::stable_sort(ranking.begin(), ranking.end(), [&winRates](int a, int b) { return winRates[a] > winRates[b]; });
+  if (winRates[ranking[0]] > state.bestWinRate) {
+    state.best = candidates[ranking[0]];
+    state.bestWinRate = winRates[ranking[0]];
+    state.bestGeneration = state.generation;
+  }
+  int elite = std::min(options.eliteCount, options.population);
+  for (int f=0; f<NUM_POLICY_FEATURES; f++) {
+    double sum = 0, sumSquares = 0;
+    for (int e=0; e<elite; e++) {
+      double weight = candidates[ranking[e]][f];
+      sum += weight;
+      sumSquares += weight * weight;
+    }
+    double eliteMean = sum / elite;
+    double eliteSpread = std::sqrt(std::max(0.0, sumSquares / elite - eliteMean * eliteMean));
+    state.mean[f] += options.smoothing * (eliteMean - state.mean[f]);
+    state.spread[f] = std::max(options.minSpread, state.spread[f] + options.smoothing * (eliteSpread - state.spread[f]));
+  }
+  state.generation++;
+  return winRates;
+}
+
+/*CHECKPOINTS
+A text file rewritten after every generation: the settings that must match to resume, then the search state.
+Numbers are written with 17 significant digits, so a resumed search continues exactly where it stopped.
+*/
+
+const char *const TUNING_CHECKPOINT_HEADER = "wargame-tuning 2"; //2: the greedy features were dropped
+
+inline std::string joinNames(const std::vector<std::string> &names) {
+  std::string joined;
+  for (size_t i=0; i<names.size(); i++) {
+    joined += (i > 0 ? "," : "") + names[i];
+  }
+  return joined;
+}
+
+/*tuningSettings
+Purpose: the lines of a checkpoint that describe the search (a checkpoint with different settings is not resumed)
+*/
+inline std::string tuningSettings(const TuningOptions &options) {
+  std::ostringstream settings;
+  settings << "seed " << options.seed << "\n";
+  settings << "opponents " << joinNames(options.opponentNames) << "\n";
+  settings << "deals " << options.dealsPerCandidate << "\n";
+  settings << "population " << options.population << " elite " << options.eliteCount << " smoothing " << options.smoothing << " min-spread " << options.minSpread << "\n";
+  return settings.str();
+}
+
+/*saveTuning
+Purpose: writing the state to the checkpoint file (to a temporary file first, then renamed over the old checkpoint, so a crash never leaves half a checkpoint)
+Return: false if the file could not be written
+*/
+inline bool saveTuning(const TuningOptions &options, const TuningState &state) {
+  std::string temporaryPath = options.checkpointPath + ".tmp";
+  {
+    std::ofstream file(temporaryPath);
+    file.precision(17);
+    file << TUNING_CHECKPOINT_HEADER << "\n" << tuningSettings(options);
+    file << "generation " << state.generation << "\n";
+    file << "games " << state.gamesPlayed << "\n";
+    const PolicyWeights *vectors[3] = {&state.mean, &state.spread, &state.best};
+    const char *labels[3] = {"mean", "spread", "best"};
+    for (int v=0; v<3; v++) {
+      file << labels[v];
+      for (int f=0; f<NUM_POLICY_FEATURES; f++) {
+        file << " " << (*vectors[v])[f];
+      }
+      file << "\n";
+    }
+    file << "best-win-rate " << state.bestWinRate << " generation " << state.bestGeneration << "\n";
+    if (!file.flush()) {
+      return false;
+    }
+  }
+  return std::rename(temporaryPath.c_str(), options.checkpointPath.c_str()) == 0;
+}
+
+/*loadTuning
+Purpose: reading the state back from a checkpoint file
+Parameters: options (the settings must match the file's), state that receives the saved state
+Return: "" if the state was loaded, otherwise why not
+*/
+inline std::string loadTuning(const TuningOptions &options, TuningState &state) {
+  std::ifstream file(options.checkpointPath);
+  if (!file) {
+    return "cannot open " + options.checkpointPath;
+  }
+  std::string header;
+  std::getline(file, header);
+  if (header != TUNING_CHECKPOINT_HEADER) {
+    return options.checkpointPath + " is not a tuning checkpoint";
+  }
+  //The settings lines must be exactly what these options would write
+  std::string expected = tuningSettings(options), saved;
+  for (int lines=std::count(expected.begin(), expected.end(), '\n'); lines>0; lines--) {
+    std::string line;
+    std::getline(file, line);
+    saved += line + "\n";
+  }
+  if (saved != expected) {
+    return options.checkpointPath + " was saved by a search with other settings:\n" + saved;
+  }
+  std::string label;
+  TuningState loaded;
+  file >> label >> loaded.generation >> label >> loaded.gamesPlayed;
+  PolicyWeights *vectors[3] = {&loaded.mean, &loaded.spread, &loaded.best};
+  for (int v=0; v<3; v++) {
+    file >> label;
+    for (int f=0; f<NUM_POLICY_FEATURES; f++) {
+      file >> (*vectors[v])[f];
+    }
+  }
+  file >> label >> loaded.bestWinRate >> label >> loaded.bestGeneration;
+  if (!file) {
+    return options.checkpointPath + " is damaged";
+  }
+  state = loaded;
+  return "";
+}
+
+/*VALIDATION*/
+
+//A policy's results against one opponent on the validation deals, next to a reference policy on the same deals
+struct ValidationResult {
+  MeanEstimate policy, reference;
+  MeanEstimate difference; //policy minus reference, deal by deal: common random numbers make this much tighter than the two intervals suggest
+};
+
+/*validatePolicy
+Purpose: measuring the win rates of a policy and a reference policy against each opponent on deals the search never played, in parallel
+Parameters: the policy's weights, the reference policy, options (opponents, seed, threads), number of deals per opponent
+Return: one result per opponent
+*/
+inline std::vector<ValidationResult> validatePolicy(const PolicyWeights &weights, OrderPolicy reference, const TuningOptions &options, long long deals) {
+  int numOpponents = options.opponents.size();
+  long long chunks = (deals + TUNING_CHUNK - 1) / TUNING_CHUNK;
+  WorkStealingPool pool(options.numThreads);
+  //Per task rather than per worker, so the sums are added in the same order for any number of threads
+  std::vector<ValidationResult> taskResults(numOpponents * chunks);
+  WeightedPolicy policy = {weights};
+  pool.run(numOpponents * chunks, [&](long long task, int) {
+    int opponent = task / chunks;
+    long long firstDeal = task % chunks * TUNING_CHUNK;
+    for (long long deal=firstDeal; deal<std::min(firstDeal + TUNING_CHUNK, deals); deal++) {
+      double policyScore = playDealBothSeats(policy, options.opponents[opponent], options.seed, TUNING_VALIDATION_STREAMS + deal);
+      double referenceScore = playDealBothSeats(reference, options.opponents[opponent], options.seed, TUNING_VALIDATION_STREAMS + deal);
+      taskResults[task].policy.add(policyScore);
+      taskResults[task].reference.add(referenceScore);
+      taskResults[task].difference.add(policyScore - referenceScore);
+    }
+  });
+  std::vector<ValidationResult> results(numOpponents);
+  for (long long task=0; task<numOpponents * chunks; task++) {
+    ValidationResult &result = results[task / chunks];
+    result.policy.merge(taskResults[task].policy);
+    result.reference.merge(taskResults[task].reference);
+    result.difference.merge(taskResults[task].difference);
+  }
+  return results;
+}
+
+#endif
@@ -0,0 +1,434 @@
+#ifndef WARGAME_VARIANT_H
+#define WARGAME_VARIANT_H
+
+#include <algorithm>
+#include <cstring>
+#include "card.h"
+#include "deck.h"
+#include "random.h"
+#include "simulation.h"
+
+/*RULE VARIANTS
+The headless engine of simulation.h with the rules as template parameters: hand size, number of players, and deck composition (how many 52-card decks are shuffled together, and optionally stripping the low faces, e.g. the 32-card piquet deck from Seven up).
+Every loop over the hand or the players has a compile-time bound, so each variant compiles to its own unrolled code with no runtime checks of the rules.
+
+The rules are the ones of the 2-player game, generalized:
+- the shuffled deck is dealt in equal blocks (P1 gets the first block); cards that do not divide evenly are set aside
+- each battle every player still in the game draws a hand (shuffling their discard pile in first if needed) and chooses an order
+- each sub-battle is won by the highest card played, and the winner adds every card of that sub-battle (in seat order) to their discard pile
+- identical cards (only possible with more than one deck) go to the tied player seated first, counting from a seat that moves on by one every battle, so no seat is favoured
+- after the battle, a player with fewer cards in total than a hand is out of the game and their cards are set aside; the last player left wins (if everyone left drops out in the same battle, the one with the most cards wins)
+WarRules<4, 2> plays exactly the same games as playGame() from the same Rng (checked by benchmark.cpp).
+*/
+
+constexpr int factorial(int n) {
+  return n <= 1 ? 1 : n * factorial(n-1);
+}
+
+template <int HAND, int PLAYERS, int DECKS = 1, int LOWEST = 0>
+struct WarRules {
+  static const int HAND_SIZE = HAND;
+  static const int NUM_PLAYERS = PLAYERS;
+  static const int NUM_DECKS = DECKS;
+  static const int LOWEST_FACE = LOWEST; //index into FACES of the lowest card in the deck
+  static const int CARDS_PER_DECK = (NUM_FACES - LOWEST_FACE) * NUM_SUITS;
+  static const int DECK_SIZE = NUM_DECKS * CARDS_PER_DECK;
+  static const int DEAL_SIZE = DECK_SIZE / NUM_PLAYERS; //cards dealt to each player
+  static const int NUM_ORDERS = factorial(HAND_SIZE);
+
+  static_assert(HAND_SIZE >= 1 && HAND_SIZE <= 12, "orders are drawn as one 32-bit index");
+  static_assert(NUM_PLAYERS >= 2 && NUM_PLAYERS <= 8, "2 to 8 players");
+  static_assert(LOWEST_FACE >= 0 && LOWEST_FACE < NUM_FACES, "the deck needs at least one face");
+  static_assert(DEAL_SIZE >= HAND_SIZE, "every player must be dealt at least one hand");
+  static_assert(DECK_SIZE <= 255, "at most 255 cards (4 full decks)");
+
+  typedef BasicCardPile<DECK_SIZE> Pile; //big enough for every card in play
+};
+
+typedef WarRules<4, 2> ClassicRules; //the rules of main() and playGame()
+
+//One player's cards
+template <typename Rules>
+struct VariantPlayer {
+  typename Rules::Pile deck, discard;
+
+  int totalCards() const { return deck.size() + discard.size(); }
+};
+
+//Everything on the table when a player chooses their order: every pile size and the hands shown so far (in seat order)
+//Players choose in seat order and each hand is shown as its player chooses (as in battle()), so a player sees the hands of the seats before theirs only
+template <typename Rules>
+struct VariantView {
+  const Card (*hands)[Rules::HAND_SIZE]; //hands[seat] is that player's hand; only hands[0] to hands[seat] have been shown
+  const int *deckSizes, *discardSizes; //after the hands were drawn (copies, so the piles themselves stay private to the engine and can be kept in registers)
+  const bool *inGame; //inGame[seat] is false once that player is out (their hand is then meaningless)
+  int seat; //the player choosing, from 0
+  int battleNum;
+
+  const Card *hand() const { return hands[seat]; }
+};
+
+//An order-choice policy for a variant fills order[i] with the index of the hand card to play in sub-battle i
+template <typename Rules>
+using VariantPolicy = void (*)(const VariantView<Rules> &view, unsigned char order[Rules::HAND_SIZE], Rng &rng);
+
+/*POLICIES*/
+
+/*variantFixedOrder
+Purpose: always playing the cards in the order they were drawn
+*/
+template <typename Rules>
+inline void variantFixedOrder(const VariantView<Rules> &, unsigned char order[Rules::HAND_SIZE], Rng &) {
+  for (int i=0; i<Rules::HAND_SIZE; i++) {
+    order[i] = i;
+  }
+}
+
+/*decodeOrder
+Purpose: turning an order's index into the order (the inverse of orderIndex, for any hand size): each digit of the index, in base HAND_SIZE-i with the most significant first, picks one of the hand indexes not used yet
+Parameters: index from 0 to HAND_SIZE!-1, order that receives the hand indexes
+*/
+template <int HAND_SIZE>
+constexpr void decodeOrder(uint32_t index, unsigned char order[HAND_SIZE]) {
+  unsigned char unused[HAND_SIZE] = {};
+  for (int i=0; i<HAND_SIZE; i++) {
+    unused[i] = i;
+  }
+  uint32_t place = factorial(HAND_SIZE-1);
+  for (int i=0; i<HAND_SIZE; i++) {
+    int pick = index / place;
+    index %= place;
+    order[i] = unused[pick];
+    for (int j=pick; j<HAND_SIZE-1-i; j++) {
+      unused[j] = unused[j+1];
+    }
+    place /= HAND_SIZE-1-i > 0 ? HAND_SIZE-1-i : 1;
+  }
+}
+
+//Every order of a hand in increasing order of index (ORDER_PERMUTATIONS for any hand size), built at compile time; only used up to 6 cards (720 orders)
+template <int HAND_SIZE>
+struct OrderTable {
+  unsigned char orders[factorial(HAND_SIZE)][HAND_SIZE];
+
+  constexpr OrderTable() : orders() {
+    for (int index=0; index<factorial(HAND_SIZE); index++) {
+      decodeOrder<HAND_SIZE>(index, orders[index]);
+    }
+  }
+};
+
+/*variantRandomOrder
+Purpose: playing one of the HAND_SIZE! orders chosen uniformly at random (so a 4-card hand uses the same order as randomOrder from the same Rng)
+*/
+template <typename Rules>
+inline void variantRandomOrder(const VariantView<Rules> &, unsigned char order[Rules::HAND_SIZE], Rng &rng) {
+  if constexpr (Rules::HAND_SIZE <= 6) {
+    static constexpr OrderTable<Rules::HAND_SIZE> TABLE;
+    std::memcpy(order, TABLE.orders[rng.bounded(Rules::NUM_ORDERS)], Rules::HAND_SIZE);
+  }
+  else {
+    decodeOrder<Rules::HAND_SIZE>(rng.bounded(Rules::NUM_ORDERS), order);
+  }
+}
+
+/*variantAscendingOrder
+Purpose: playing the weakest card first and the strongest card last
+*/
+template <typename Rules>
+inline void variantAscendingOrder(const VariantView<Rules> &view, unsigned char order[Rules::HAND_SIZE], Rng &) {
+  const Card *hand = view.hand();
+  for (int i=0; i<Rules::HAND_SIZE; i++) {
+    order[i] = i;
+  }
+  std::sort(order, order+Rules::HAND_SIZE, [hand](unsigned char a, unsigned char b) { return hand[a] < hand[b]; });
+}
+
+/*variantDescendingOrder
+Purpose: playing the strongest card first and the weakest card last
+*/
+template <typename Rules>
+inline void variantDescendingOrder(const VariantView<Rules> &view, unsigned char order[Rules::HAND_SIZE], Rng &) {
+  const Card *hand = view.hand();
+  for (int i=0; i<Rules::HAND_SIZE; i++) {
+    order[i] = i;
+  }
+  std::sort(order, order+Rules::HAND_SIZE, [hand](unsigned char a, unsigned char b) { return hand[a] > hand[b]; });
+}
+
+/*variantGreedyOrder
+Purpose: greedyOrder against every opponent whose hand has been shown: assuming they all play in drawn order, the card to beat in each slot is the highest shown opponent card in it; beat those (weakest first) with the weakest card that still wins, and throw the leftover cards into the slots that cannot be won
+With no opponent hand shown (the first seat still in the game) it plays a random order, like greedyOrder as P1
+*/
+template <typename Rules>
+inline void variantGreedyOrder(const VariantView<Rules> &view, unsigned char order[Rules::HAND_SIZE], Rng &rng) {
+  const Card *hand = view.hand();
+  bool opponentShown = false;
+  for (int p=0; p<view.seat; p++) {
+    opponentShown = opponentShown || view.inGame[p];
+  }
+  if (!opponentShown) {
+    variantRandomOrder(view, order, rng);
+    return;
+  }
+  int toBeat[Rules::HAND_SIZE];
+  for (int slot=0; slot<Rules::HAND_SIZE; slot++) {
+    toBeat[slot] = -1;
+    for (int p=0; p<view.seat; p++) {
+      if (view.inGame[p]) {
+        toBeat[slot] = std::max<int>(toBeat[slot], view.hands[p][slot]);
+      }
+    }
+  }
+  //Slots from the easiest to the hardest to win
+  unsigned char slots[Rules::HAND_SIZE];
+  for (int i=0; i<Rules::HAND_SIZE; i++) {
+    slots[i] = i;
+  }
+  std::sort(slots, slots+Rules::HAND_SIZE, [&toBeat](unsigned char a, unsigned char b) { return toBeat[a] < toBeat[b]; });
+  bool used[Rules::HAND_SIZE] = {}, filled[Rules::HAND_SIZE] = {};
+  for (int s=0; s<Rules::HAND_SIZE; s++) {
+    int slot = slots[s];
+    int best = -1;
+    for (int j=0; j<Rules::HAND_SIZE; j++) {
+      if (!used[j] && hand[j] > toBeat[slot] && (best == -1 || hand[j] < hand[best])) {
+        best = j;
+      }
+    }
+    if (best != -1) {
+      order[slot] = best;
+      used[best] = true;
+      filled[slot] = true;
+    }
+  }
+  //Cards that cannot win anything go to the remaining slots
+  int next = 0;
+  for (int slot=0; slot<Rules::HAND_SIZE; slot++) {
+    if (!filled[slot]) {
+      while (used[next]) {
+        next++;
+      }
+      order[slot] = next;
+      used[next] = true;
+    }
+  }
+}
+
+/*findVariantPolicy
+Purpose: looking up a variant policy by the name of the matching policy in POLICIES (fixed, random, ascending, descending or greedy; the solver policies only know 4-card hands against one opponent)
+Parameters: name of the policy
+Return: the policy, or nullptr if no variant policy has that name
+*/
+template <typename Rules>
+inline VariantPolicy<Rules> findVariantPolicy(const char *name) {
+  const struct {
+    const char *name;
+    VariantPolicy<Rules> policy;
+  } VARIANT_POLICIES[] = {
+    {"fixed", variantFixedOrder<Rules>},
+    {"random", variantRandomOrder<Rules>},
+    {"ascending", variantAscendingOrder<Rules>},
+    {"descending", variantDescendingOrder<Rules>},
+    {"greedy", variantGreedyOrder<Rules>}
+  };
+  for (const auto &entry : VARIANT_POLICIES) {
+    if (std::strcmp(entry.name, name) == 0) {
+      return entry.policy;
+    }
+  }
+  return nullptr;
+}
+
+/*GAME*/
+
+/*dealVariant
+Purpose: shuffling the variant's deck and dealing each player an equal block of it
+Parameters: every player's state, random number generator
+*/
+template <typename Rules>
+inline void dealVariant(VariantPlayer<Rules> players[Rules::NUM_PLAYERS], Rng &rng) {
+  Card fullDeck[Rules::DECK_SIZE];
+  for (int d=0; d<Rules::NUM_DECKS; d++) {
+    for (int i=0; i<Rules::CARDS_PER_DECK; i++) {
+      fullDeck[d*Rules::CARDS_PER_DECK + i] = Rules::LOWEST_FACE*NUM_SUITS + i;
+    }
+  }
+  shuffleInPlace(fullDeck, Rules::DECK_SIZE, rng);
+  for (int p=0; p<Rules::NUM_PLAYERS; p++) {
+    players[p].deck.assign(fullDeck + p*Rules::DEAL_SIZE, Rules::DEAL_SIZE);
+    players[p].discard.clear();
+  }
+}
+
+/*playVariantBattles
+Purpose: playing battles of a variant (refilling decks, drawing, choosing orders, playing the sub-battles and putting out players with fewer cards than a hand) until one player is left or the battle limit is reached
+Parameters: every player's state, every player's policy, which seats are still in the game and how many, random number generator, number of battles after which the game is abandoned, the game's result so far (battles, reshuffles, and the winner if everyone left drops out in the same battle)
+EVERYONE_IN is true while no player is out: that loop has no checks of inGame at all, and returns as soon as a player is out so the rest of the game is played by the other version
+*/
+template <typename Rules, bool EVERYONE_IN>
+inline void playVariantBattles(VariantPlayer<Rules> players[Rules::NUM_PLAYERS], const VariantPolicy<Rules> seatPolicies[Rules::NUM_PLAYERS], bool inGame[Rules::NUM_PLAYERS], int &seatsLeft, Rng &rng, int maxBattles, GameResult &gameResult) {
+  const int N = Rules::NUM_PLAYERS, H = Rules::HAND_SIZE;
+  //Local copies: every card written could alias memory reached through a pointer (Card is a char type), so anything behind one would be reloaded after each card
+  VariantPolicy<Rules> policies[N];
+  std::copy(seatPolicies, seatPolicies+N, policies);
+  GameResult result = gameResult;
+  int playersLeft = seatsLeft;
+  while (result.battles < maxBattles && playersLeft > 1) {
+    result.battles++;
+    //Shuffle in cards if the deck size is below a hand, then draw
+    for (int p=0; p<N; p++) {
+      if ((EVERYONE_IN || inGame[p]) && players[p].deck.size() < H) {
+        refillDeck(players[p], rng);
+        result.reshuffles++;
+      }
+    }
+    Card hands[N][H];
+    for (int p=0; p<N; p++) {
+      if (EVERYONE_IN || inGame[p]) {
+        players[p].deck.draw(hands[p], H);
+      }
+    }
+    //Get the order choices in seat order
+    int deckSizes[N], discardSizes[N];
+    for (int p=0; p<N; p++) {
+      deckSizes[p] = players[p].deck.size();
+      discardSizes[p] = players[p].discard.size();
+    }
+    unsigned char orders[N][H];
+    for (int p=0; p<N; p++) {
+      if (EVERYONE_IN || inGame[p]) {
+        VariantView<Rules> view = {hands, deckSizes, discardSizes, inGame, p, result.battles};
+        policies[p](view, orders[p], rng);
+      }
+    }
+    //Sub-battles: the highest card takes every card played in it
+    int firstSeat = Rules::NUM_DECKS > 1 ? result.battles % N : 0; //wins ties between identical cards
+    for (int i=0; i<H; i++) {
+      Card pot[N];
+      int potSize = 0, winner = -1;
+      Card best = 0;
+      for (int p=0; p<N; p++) {
+        if (EVERYONE_IN || inGame[p]) {
+          Card card = hands[p][orders[p][i]];
+          pot[potSize++] = card;
+          //Identical cards: the later seat only wins if the earlier one comes before firstSeat
+          if (winner == -1 || card > best || (Rules::NUM_DECKS > 1 && card == best && winner < firstSeat && p >= firstSeat)) {
+            winner = p;
+            best = card;
+          }
+        }
+      }
+      players[winner].discard.pushBack(pot, potSize);
+    }
+    //Players with fewer cards than a hand are out
+    int mostCards = -1, mostCardsCount = -1;
+    for (int p=0; p<N; p++) {
+      if ((EVERYONE_IN || inGame[p]) && players[p].totalCards() < H) {
+        inGame[p] = false;
+        playersLeft--;
+        if (players[p].totalCards() > mostCardsCount) {
+          mostCards = p;
+          mostCardsCount = players[p].totalCards();
+        }
+        players[p].deck.clear();
+        players[p].discard.clear();
+      }
+    }
+    if (playersLeft == 0) { //everyone left dropped out at once
+      result.winner = mostCards + 1;
+    }
+    if (EVERYONE_IN && playersLeft < N) {
+      break;
+    }
+  }
+  gameResult = result;
+  seatsLeft = playersLeft;
+}
+
+/*continueVariant
+Purpose: playing a game of a variant from the given piles until one player is left, without any I/O
+Parameters: every player's state (updated as the game is played), every player's policy, random number generator, number of battles after which the game is abandoned
+Return: the winner (seat number from 1, or 0 if the game was abandoned), the number of battles and the number of reshuffles
+*/
+template <typename Rules>
+inline GameResult continueVariant(VariantPlayer<Rules> players[Rules::NUM_PLAYERS], const VariantPolicy<Rules> policies[Rules::NUM_PLAYERS], Rng &rng, int maxBattles) {
+  const int N = Rules::NUM_PLAYERS;
+  GameResult result = {0, 0, 0};
+  bool inGame[N];
+  int playersLeft = 0;
+  for (int p=0; p<N; p++) {
+    inGame[p] = players[p].totalCards() >= Rules::HAND_SIZE;
+    playersLeft += inGame[p];
+  }
+  if (playersLeft == N) {
+    playVariantBattles<Rules, true>(players, policies, inGame, playersLeft, rng, maxBattles, result);
+  }
+  playVariantBattles<Rules, false>(players, policies, inGame, playersLeft, rng, maxBattles, result);
+  for (int p=0; p<N && playersLeft == 1; p++) {
+    if (inGame[p]) {
+      result.winner = p + 1;
+    }
+  }
+  return result;
+}
+
+/*playVariant
+Purpose: dealing and playing one complete game of a variant without any I/O
+Parameters: every player's policy, random number generator, number of battles after which the game is abandoned
+Return: the winner and the length of the game (see continueVariant)
+*/
+template <typename Rules>
+inline GameResult playVariant(const VariantPolicy<Rules> policies[Rules::NUM_PLAYERS], Rng &rng, int maxBattles = SIM_DEFAULT_MAX_BATTLES) {
+  VariantPlayer<Rules> players[Rules::NUM_PLAYERS];
+  dealVariant<Rules>(players, rng);
+  return continueVariant<Rules>(players, policies, rng, maxBattles);
+}
+
+/*AGGREGATE STATISTICS*/
+
+//SimStats with a win count for every seat
+template <typename Rules>
+struct VariantStats {
+  SimStats lengths; //game lengths and reshuffles (its p1Wins/p2Wins/unfinished are not used)
+  long long wins[Rules::NUM_PLAYERS] = {}; //wins[seat] for seats from 0
+  long long unfinished = 0;
+
+  void record(const GameResult &result) {
+    GameResult length = result;
+    length.winner = 0;
+    lengths.record(length);
+    if (result.winner == 0) {
+      unfinished++;
+    }
+    else {
+      wins[result.winner-1]++;
+    }
+  }
+
+  void merge(const VariantStats &other) {
+    lengths.merge(other.lengths);
+    for (int p=0; p<Rules::NUM_PLAYERS; p++) {
+      wins[p] += other.wins[p];
+    }
+    unfinished += other.unfinished;
+  }
+
+  long long games() const { return lengths.games; }
+};
+
+/*runVariantSimulation
+Purpose: playing a batch of games of a variant from one seed (game i on stream i, as in runSimulation)
+Parameters: number of games, master seed, every player's policy, number of battles after which a game is abandoned, number of the first game
+Return: wins per seat and game-length statistics
+*/
+template <typename Rules>
+inline VariantStats<Rules> runVariantSimulation(long long games, uint64_t seed, const VariantPolicy<Rules> policies[Rules::NUM_PLAYERS], int maxBattles = SIM_DEFAULT_MAX_BATTLES, long long firstGame = 0) {
+  VariantStats<Rules> stats;
+  for (long long i=firstGame; i<firstGame+games; i++) {
+    Rng rng(seed, i);
+    stats.record(playVariant<Rules>(policies, rng, maxBattles));
+  }
+  return stats;
+}
+
+#endif
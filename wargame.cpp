@@ -1,449 +1,1206 @@
 #include <iostream>
 #include <string>
 #include <vector>
-#include <map>
 #include <cstdlib> 
-#include <ctime> //cstdlib and ctime are used for random number generation
+#include <ctime> //ctime is used to seed the random number generator
+#include <chrono>
+#include <iomanip>
+#include <cstring>
+#include "card.h"
+#include "deck.h"
+#include "random.h"
+#include "renderer.h"
+#include "policies.h"
+#include "simulation.h"
+#include "tournament.h"
+#include "record.h"
+#include "analyzer.h"
+#include "session.h"
+#include "variant.h"
+#include "server.h"
 using namespace std;
 
 /*GLOBAL VARIABLES*/
 
+bool quietMode = false; //set by --quiet: battle details are not printed (human players still see their own cards)
+bool showOdds = false; //set by --odds: each player's chance of winning the war is shown after every battle
+
 //Constant strings to change the colour of the text and the highlight of the text (HL for highlight)
-const string RESET = "\033[0m";
-const string BLACKTEXT = "\033[30m";
-const string REDTEXT = "\033[31m";
-const string REDHL = "\033[41m";
-const string GREENTEXT = "\033[32m"; 
-const string GREENHL = "\033[42m";
-const string YELLOWTEXT = "\033[33m";
-const string YELLOWHL = "\033[43m";
-const string BLUETEXT = "\033[34m";
-const string BLUEHL = "\033[44m";
-const string PURPLETEXT = "\033[35m";
-const string PURPLEHL = "\033[45m";
-const string CYANTEXT = "\033[36m";
-const string CYANHL = "\033[46m";
-const string WHITETEXT = "\033[37m";
-const string WHITEHL = "\033[47m";
-string colours[2][7] = {{"",REDTEXT,GREENTEXT,YELLOWTEXT,BLUETEXT,PURPLETEXT,CYANTEXT}, {"",REDHL,GREENHL,YELLOWHL,BLUEHL,PURPLEHL,CYANHL}}; //a 1-indexed 2D array that will be used to print output for each player in their selected colours
-
-//Constant string arrays with faces and suits, sorted in increasing order of value
-const string FACES[13] = {"Deuce", "Three", "Four", "Five", "Six", "Seven", "Eight", "Nine", "Ten", "Jack", "Queen", "King", "Ace"};
-const string SUITS[4] = {"Spades", "Hearts", "Diamonds", "Clubs"};
-
-//Maps used to convert from the constant string arrays to their values for easier card comparison
-map<string, int> convertFaces; //key: face, value: numerical equivalent of face
-map<string, int> convertSuits; //key: suit, value: values assigned from 1-4 to represent the suit's relative value
-
-//Player info
-string p1_name, p2_name;
-int p1_colour, p2_colour;
-int p1_score = 0, p2_score = 0;
-
-//Vectors of pair<string,string> to represent card decks (original deck, each player's deck, each player's discard pile); pair<string,string> represents each card as {face, suit}
-vector < pair<string,string> > originalDeck, p1_deck, p2_deck, p1_discard, p2_discard;
-
-/*METHODS*/
-
-/*setup method
-Purpose: creating the original deck, creating conversion maps (all variables defined above)
+const char *const RESET = "\033[0m";
+const char *const BLACKTEXT = "\033[30m";
+const char *const REDTEXT = "\033[31m";
+const char *const REDHL = "\033[41m";
+const char *const GREENTEXT = "\033[32m"; 
+const char *const GREENHL = "\033[42m";
+const char *const YELLOWTEXT = "\033[33m";
+const char *const YELLOWHL = "\033[43m";
+const char *const BLUETEXT = "\033[34m";
+const char *const BLUEHL = "\033[44m";
+const char *const PURPLETEXT = "\033[35m";
+const char *const PURPLEHL = "\033[45m";
+const char *const CYANTEXT = "\033[36m";
+const char *const CYANHL = "\033[46m";
+const char *const WHITETEXT = "\033[37m";
+const char *const WHITEHL = "\033[47m";
+const char *const colours[2][7] = {{"",REDTEXT,GREENTEXT,YELLOWTEXT,BLUETEXT,PURPLETEXT,CYANTEXT}, {"",REDHL,GREENHL,YELLOWHL,BLUEHL,PURPLEHL,CYANHL}}; //a 1-indexed 2D array that will be used to print output for each player in their selected colours
+
+//Computer strategies offered when setting up a player, from easiest to hardest
+const string COMPUTER_LEVELS[3] = {"Easy", "Medium", "Hard"};
+const char *const COMPUTER_POLICIES[3] = {"random", "greedy", "counter"}; //random order, greedy heuristic, solver (see counterGreedyPolicy in solver.h); as P1 the last two play a random order, since P2's cards are not shown yet
+
+//The 4 pages of game instructions, each shown after pressing ENTER
+const string INSTRUCTIONS[4] = {
+  string("War is a 2 player card game played with a standard 52-card deck. The goal of both players (") + BLACKTEXT + WHITEHL + "P1" + RESET + " and " + BLACKTEXT + WHITEHL + "P2" + RESET + ") is to win all 52 cards by winning battles." + "\n",
+  string("To start, the deck is shuffled and divided evenly among the 2 players (26 cards in each deck). In each battle, both players will draw the top 4 cards from their deck, look at them, and choose the order to play them in. The 4 cards drawn will be labelled 1, 2, 3, and 4. To select an order, you must enter a 4-digit sequence with each of these digits appearing exactly once (e.g. 1234, 3412, 4123, etc.).") + "\n",
+  string("Once each player has chosen the order their cards will be played, their cards are compared one-on-one in this order. In each of these 4 sub-battles, the player with the stronger card wins and adds both the card they played and the other player’s losing card to their discard pile.") + "\n" + "\n"
+    + "The stronger card is the one with the higher face value: " + BLACKTEXT + WHITEHL + "Ace > King > Queen > Jack > Ten > Nine > Eight > Seven > Six > Five > Four > Three > Deuce" + RESET + ". If two cards have the same face value, then the stronger card is the one with the higher suit value: " + BLACKTEXT + WHITEHL + "Clubs > Diamonds > Hearts > Spades" + RESET + "." + "\n",
+  string("P1 and P2 continue battling repeatedly. If a player is unable to draw 4 cards from their deck, their discard pile is shuffled into their deck. However, if a player is unable to draw 4 cards from their deck even with the discard pile added in (i.e. they have fewer than 4 cards in total), then they LOSE.") + "\n" + "\n" + "At the end of a game of War, the winner will earn 100 points. Then, you may choose to have a rematch by playing again!" + "\n"
+};
+const char *const INSTRUCTION_PROMPTS[4] = {"CONTINUE", "CONTINUE", "CONTINUE", "BEGIN"};
+
+/*INTERACTIVE GAME
+The game is a state machine: each state is a prompt waiting for one line of input, and input() handles the answer and plays on until the next prompt, so nothing ever blocks waiting for a player.
+main() feeds it lines from the terminal; the server (--serve, see server.h) runs one GameFlow per connection and feeds it lines from its socket.
+All of the game's state is in the GameSession (see session.h) and the flow's own renderer; the tables above are constant and shared.
 */
-void setup() {
-  //Creating the original deck
-  for (int i=0; i<13; i++) {
-    for (int j=0; j<4; j++) {
-      pair<string, string> currentCard = {FACES[i], SUITS[j]}; //build the currentCard by selecting a face and a suit
-      originalDeck.push_back(currentCard); //add the currentCard pair to the originalDeck vector
+class GameFlow {
+public:
+  enum State { INSTRUCTIONS_PAGE, PLAYER_TYPE, PLAYER_NAME, PLAYER_COLOUR, READY, ORDER, NEXT_BATTLE, SCORES, AGAIN, FINISHED };
+
+  GameSession game;
+  Renderer screen; //all of this game's output, flushed (or drained by the server) whenever the flow waits for input
+
+  /*GameFlow constructor
+  Parameters: seed for the game's random number generator, file descriptor the output is written to (-1 to only collect it, see Renderer::drainTo)
+  */
+  GameFlow(uint64_t seed, int fileDescriptor) : game(seed), screen(fileDescriptor) {}
+
+  State getState() const { return state; }
+  bool finished() const { return state == FINISHED; }
+
+  /*start
+  Purpose: welcoming the users and showing the first prompt
+  */
+  void start() {
+    printWithCircles("Welcome to the War Game !");
+    //Game instructions
+    page = 0;
+    pressEnter(INSTRUCTIONS_PAGE, "READ THE GAME INSTRUCTIONS");
+    playOn();
+  }
+
+  /*input
+  Purpose: handling one line of input for the current prompt, then playing on until the next prompt (or the end of the game)
+  Parameters: the line, without its newline
+  */
+  void input(const string &line) {
+    if (state != FINISHED) {
+      handle(line);
     }
+    playOn();
   }
-  //Creating maps to convert from faces and suits to numerical values 
-  for (int i=0; i<13; i++) {
-    convertFaces.insert({FACES[i], i+2});
+
+  /*compareCards
+  Purpose: playing the 4 sub-battles of the battle in the chosen orders (GameSession::finishBattle) and displaying who won each
+  Parameter: both players' order choices (indexes into their hands)
+  */
+  void compareCards(const unsigned char p1_order[4], const unsigned char p2_order[4]) {
+    game.finishBattle(p1_order, p2_order);
+    for (int i=0; i<4; i++) { //loop 4 times to cover all sub-battles
+      int winner = game.subBattleWinners[i];
+      screen << colours[0][game.player(winner).colour] << "Sub-battle " << i+1 << ": P" << winner << " wins with " << cardName(game.played[winner-1][i]);
+      screen << RESET << "\n";
+    }  
   }
-  for (int i=0; i<4; i++) {
-    convertSuits.insert({SUITS[i], i+1});
+
+private:
+  State state = INSTRUCTIONS_PAGE;
+  bool waiting = true; //false when the current prompt is skipped (see pressEnter)
+  int page = 0; //instructions page shown last
+  int playerNum = 1; //the player being set up, or choosing their order
+  unsigned char orders[2][4]; //the battle's order choices so far
+  chrono::steady_clock::time_point battleStart; //for the instrumentation only
+
+  /*playOn
+  Purpose: skipping the prompts nobody needs to answer (ENTER when both players are computers), then writing out everything up to the next prompt
+  */
+  void playOn() {
+    while (!waiting && state != FINISHED) {
+      handle("");
+    }
+    screen.flush();
   }
-}
 
-/*pressEnter method
-Purpose: spacing large sections of output to improve readability and create a game-like environment
-Parameters: string that describes what is coming after pressing ENTER
-*/
-void pressEnter(string message) {
-  cout << endl << "[PRESS ENTER TO " << message << "]" << endl;
-  string empty;
-  getline(cin, empty);
-}
+  /*handle
+  Purpose: acting on the answer to the current prompt
+  Parameters: the line of input
+  */
+  void handle(const string &line) {
+    waiting = true;
+    switch (state) {
+      case INSTRUCTIONS_PAGE:
+        if (page < 4) {
+          screen << INSTRUCTIONS[page];
+          pressEnter(INSTRUCTIONS_PAGE, INSTRUCTION_PROMPTS[page]);
+          page++;
+        }
+        else { //collecting P1 and P2 info
+          askPlayerType(1);
+        }
+        break;
+      case PLAYER_TYPE:
+        answerPlayerType(firstWord(line));
+        break;
+      case PLAYER_NAME:
+        game.player(playerNum).name = line; //the whole line, in case they enter more than one word
+        screen << "\n" << "Nice to meet you, " << line << "! :)" << "\n";
+        askColour();
+        break;
+      case PLAYER_COLOUR:
+        answerColour(firstWord(line));
+        break;
+      case READY:
+        startWar();
+        break;
+      case ORDER:
+        answerOrder(firstWord(line));
+        break;
+      case NEXT_BATTLE:
+        startBattle();
+        break;
+      case SCORES:
+        screen << colours[0][game.player(1).colour] << "P1: " << game.player(1).score << RESET << "\n";
+        screen << colours[0][game.player(2).colour] << "P2: " << game.player(2).score << RESET << "\n";
+        screen << "\n";
+        screen << "Would you like to start another game of War? Enter YES or NO (case sensitive): ";
+        state = AGAIN;
+        break;
+      case AGAIN:
+        answerAgain(firstWord(line));
+        break;
+      case FINISHED:
+        break;
+    }
+  }
 
-/*printWithCircles method
-Purpose: printing messages with a border of circles
-Parameter: string message to be printed
-*/
-void printWithCircles(string message) {
-  if (message.length() %2 == 0) { //only handling messages with an odd length
-    message += " ";
+  /*firstWord
+  Purpose: the first word of a line, for the prompts that used to read one word with cin >> (an empty line gives an empty word, which every prompt ignores)
+  The rest of the line is dropped: each line answers exactly one prompt, so "1 2" at the player type prompt no longer carries the 2 over to the next prompt as cin >> did
+  */
+  static string firstWord(const string &line) {
+    size_t start = line.find_first_not_of(" \t\r");
+    if (start == string::npos) {
+      return "";
+    }
+    return line.substr(start, line.find_first_of(" \t\r", start) - start);
+  }
+
+  /*pressEnter method
+  Purpose: spacing large sections of output to improve readability and create a game-like environment
+  Parameters: state that continues after ENTER, string that describes what is coming after pressing ENTER
+  */
+  void pressEnter(State next, const string &message) {
+    state = next;
+    if (game.everyoneComputer()) { //nobody at the keyboard needs the pause
+      waiting = false;
+      return;
+    }
+    screen << "\n" << "[PRESS ENTER TO " << message << "]" << "\n";
   }
-  //Building the row of ○ ○ ○...
-  string circleSegment = " ○ ";
-  for (int i=0; i<=message.length(); i+=2) {
+
+  /*printWithCircles method
+  Purpose: printing messages with a border of circles
+  Parameter: string message to be printed
+  */
+  void printWithCircles(string message) {
+    if (message.length() %2 == 0) { //only handling messages with an odd length
+      message += " ";
+    }
+    //Building the row of ○ ○ ○...
+    string circleSegment = " ○ ";
+    for (size_t i=0; i<=message.length(); i+=2) {
+      circleSegment += "○ ";
+    }
     circleSegment += "○ ";
+    //Printing completed arrangement
+    screen << BLACKTEXT << WHITEHL << circleSegment << RESET << "\n";
+    screen << BLACKTEXT << WHITEHL << " ○ " << message << " ○ " << RESET << "\n";
+    screen << BLACKTEXT << WHITEHL << circleSegment << RESET << "\n";
   }
-  circleSegment += "○ ";
-  //Printing completed arrangement
-  cout << BLACKTEXT << WHITEHL << circleSegment << RESET << endl;
-  cout << BLACKTEXT << WHITEHL << " ○ " << message << " ○ " << RESET << endl;
-  cout << BLACKTEXT << WHITEHL << circleSegment << RESET << endl;
-}
 
-/*getColourChoice
-Purpose: displaying colour options, prompting users for a valid colour choice, error-trapping to ensure validity (and repeatedly prompting until a valid choice is made)
-Parameters: string that adds "DIFFERENT " to indicate that P2 cannot choose the same colour as P1
-Return: int that is the player's colour choice
-*/
-int getColourChoice(string extraMessage) {
-  //Displaying colour options
-  cout << REDHL<<"1. Red"<<RESET<<"   " << GREENHL<<"2. Green"<<RESET<<"   " << YELLOWHL<<"3. Yellow"<<RESET<<"   " << BLUEHL<<"4. Blue"<<RESET<<"   " << PURPLEHL<<"5. Purple"<<RESET<<"   " << CYANHL<<"6. Cyan"<<RESET << endl;
-  //Prompting
-  cout << "Please select a " << extraMessage << "colour from the options listed above (enter a digit from 1-6): ";
-  string tempColourChoice;
-  int colourChoice;
-  //Getting user input until a valid entry is made
-  while (true) {
-    cin >> tempColourChoice;
+  /*askPlayerType
+  Purpose: asking whether a seat is played by a human or the computer (and how strong the computer is)
+  Parameters: int that is the player number
+  */
+  void askPlayerType(int seat) {
+    playerNum = seat;
+    screen << "P" << playerNum << " - Who is playing this seat? 1. Human";
+    for (int i=0; i<3; i++) {
+      screen << "   " << i+2 << ". Computer (" << COMPUTER_LEVELS[i] << ")";
+    }
+    screen << "\n" << "Enter a digit from 1-4: ";
+    state = PLAYER_TYPE;
+  }
+  /*answerPlayerType
+  Purpose: error-trapping the player type, then naming the computer and giving it a colour nobody else has, or asking a human for their name
+  Parameters: the player's entry
+  */
+  void answerPlayerType(const string &tempType) {
+    if (tempType.empty()) {
+      return;
+    }
+    if (tempType.length() != 1 || tempType.at(0) < '1' || tempType.at(0) > '4') {
+      screen << "Invalid choice. Please enter a digit from 1-4: ";
+      return;
+    }
+    screen << "\n";
+    int level = tempType.at(0) - '1'; //0 for a human, otherwise the computer's level (1-3, an index into COMPUTER_LEVELS plus 1)
+    Player &player = game.player(playerNum);
+    if (level > 0) {
+      player.policy = findPolicyIndex(COMPUTER_POLICIES[level-1]);
+      player.name = "Computer (" + COMPUTER_LEVELS[level-1] + ")";
+      player.colour = (takenColour() == 1) ? 2 : 1; //the first colour P1 has not taken
+      screen << colours[1][player.colour] << "P" << playerNum << " is " << player.name << RESET << "\n" << "\n";
+      nextPlayer();
+      return;
+    }
+    screen << "P" << playerNum << " - Please enter your name: ";
+    state = PLAYER_NAME;
+  }
+  //The colour P2 may not choose (0 when choosing for P1)
+  int takenColour() const { return playerNum == 1 ? 0 : game.player(1).colour; }
+
+  /*askColour
+  Purpose: displaying colour options and prompting the user for a colour choice (P2 cannot choose the same colour as P1)
+  */
+  void askColour() {
+    //Displaying colour options
+    screen << REDHL<<"1. Red"<<RESET<<"   " << GREENHL<<"2. Green"<<RESET<<"   " << YELLOWHL<<"3. Yellow"<<RESET<<"   " << BLUEHL<<"4. Blue"<<RESET<<"   " << PURPLEHL<<"5. Purple"<<RESET<<"   " << CYANHL<<"6. Cyan"<<RESET << "\n";
+    //Prompting
+    screen << "Please select a " << (playerNum == 1 ? "" : "DIFFERENT ") << "colour from the options listed above (enter a digit from 1-6): ";
+    state = PLAYER_COLOUR;
+  }
+  /*answerColour
+  Purpose: error-trapping the colour choice (the prompt stays until a valid choice is made)
+  Parameters: the player's entry
+  */
+  void answerColour(const string &tempColourChoice) {
+    if (tempColourChoice.empty()) {
+      return;
+    }
     if (tempColourChoice.length() != 1) {
-      cout << "Invalid colour choice. Please enter a single digit from 1-6: ";
-      continue;
+      screen << "Invalid colour choice. Please enter a single digit from 1-6: ";
+      return;
     }
     if (!isdigit(tempColourChoice.at(0))) {
-      cout << "Invalid colour choice. Please enter a numerical digit from 1-6: ";
-      continue;
+      screen << "Invalid colour choice. Please enter a numerical digit from 1-6: ";
+      return;
     }
-    colourChoice = stoi(tempColourChoice); //convert after confirming the input is an int
+    int colourChoice = tempColourChoice.at(0) - '0'; //convert after confirming the input is a digit
     if (colourChoice < 1 || colourChoice > 6) {
-      cout << "Invalid colour choice. Please enter a digit from 1-6: ";
-      continue;
+      screen << "Invalid colour choice. Please enter a digit from 1-6: ";
+      return;
     }
-    if (colourChoice == p1_colour) { //p2 chose the same colour as p1
-      cout << "Invalid colour choice. Please do not choose the same colour as P1: ";
-      continue;
+    if (colourChoice == takenColour()) { //p2 chose the same colour as p1
+      screen << "Invalid colour choice. Please do not choose the same colour as P1: ";
+      return;
     }
-    else { //valid colour choice
-      string empty;
-      getline(cin, empty); //to re-align cin
-      cout << endl;
-      return colourChoice;
+    //valid colour choice
+    screen << "\n";
+    game.player(playerNum).colour = colourChoice;
+    nextPlayer();
+  }
+
+  /*nextPlayer
+  Purpose: moving on to P2's setup after P1's, or getting ready to play after P2's
+  */
+  void nextPlayer() {
+    if (playerNum == 1) {
+      askPlayerType(2);
+      return;
     }
+    const Player &p1 = game.player(1), &p2 = game.player(2);
+    screen << BLACKTEXT << WHITEHL << "Great! And now... it's time to play War!" << RESET << "\n";
+    screen << "\n" << colours[1][p1.colour] << p1.name << RESET <<" and " << colours[1][p2.colour] << p2.name << RESET << ", ARE YOU READY?" << RESET << "\n";
+    pressEnter(READY, "PLAY");
   }
-}
-/*welcome
-Purpose: welcoming the users, providing game instructions, and collecting player info (names, colour choice)
+
+  /*startWar
+  Purpose: dealing a new war and starting its first battle
+  */
+  void startWar() {
+    game.startWar(); //the session counts the rounds of War played
+    printWithCircles(("WAR " + to_string(game.warNum)));
+    screen << "\n";
+    startBattle();
+  }
+
+  /*startBattle
+  Purpose: executing the start of the next battle (reshuffles, card counts and the draw) and asking P1 for their order
+  */
+  void startBattle() {
+    if (INSTRUMENT_ENABLED) {
+      battleStart = chrono::steady_clock::now();
+    }
+    const Player &p1 = game.player(1), &p2 = game.player(2);
+    screen.setMuted(quietMode);
+    //Shuffle in cards if the deck size is below 4
+    game.startBattle();
+    screen << BLACKTEXT << WHITEHL << " * * * BATTLE " << game.battleNum <<" * * * " <<RESET << "\n";
+    if (game.reshuffled[0]) {
+      screen << colours[1][p1.colour] << "P1 - Shuffling discard pile..." << RESET << "\n";
+    }
+    if (game.reshuffled[1]) {
+      screen << colours[1][p2.colour] << "P2 - Shuffling discard pile..." << RESET << "\n";
+    }
+    //Display the size of each player's deck and discard piles
+    screen << "\n" << "~ CURRENT CARD COUNT ~" << "\n";
+    screen << colours[0][p1.colour] << "P1 deck: " << p1.cards.deck.size() << " cards" << "\n";
+    screen << "P1 discard: " << p1.cards.discard.size() << " cards" << RESET << "\n";
+    screen << colours[0][p2.colour] << "P2 deck: " << p2.cards.deck.size() << " cards" << "\n";
+    screen << "P2 discard: " << p2.cards.discard.size() << " cards" << RESET << "\n" << "\n";
+    //Draw the top 4 cards from each player's deck - these are their current hands
+    game.drawHands();
+    //Get the players' order choices (for how they wish to play their four cards)
+    askOrder(1);
+  }
+
+  /*askOrder
+  Purpose: displaying a player's 4 cards and prompting for their order choice, or letting the computer choose it
+  Parameters: int that is the player number
+  */
+  void askOrder(int seat) {
+    playerNum = seat;
+    const Player &player = game.player(playerNum);
+    screen.setMuted(quietMode && player.isComputer()); //a human always needs to see their cards and the prompt
+    //Displaying with the correct highlight colour
+    screen << colours[1][player.colour];
+    screen << "P" << playerNum << " - Here are your 4 cards:" << RESET << "\n";
+    //Loop through the player's hand to output the 4 top cards
+    for (int i=0; i<4; i++) {
+      screen << i+1 << ". " << cardName(game.hands[playerNum-1][i]) << "\n";    
+    }
+    //Displaying with the correct text colour
+    screen << colours[0][player.colour];
+    if (player.isComputer()) {
+      game.computerOrder(playerNum, orders[playerNum-1]);
+      string choice;
+      for (int i=0; i<4; i++) {
+        choice += (char)('1' + orders[playerNum-1][i]);
+      }
+      screen << player.name << " plays its cards in the order " << choice << RESET << "\n" << "\n";
+      orderChosen();
+      return;
+    }
+    screen << "Enter the order you would like to play your cards in (enter the corresponding 4-digit number): ";
+    state = ORDER;
+  }
+  /*answerOrder
+  Purpose: error-trapping a human's order entry to ensure it is a permutation of 1234 (the prompt stays until it is)
+  Parameters: the player's entry
+  */
+  void answerOrder(const string &choice) {
+    if (choice.empty() || !isValidOrder(choice)) { //invalid choice, keep waiting
+      return;
+    }
+    for (int i=0; i<4; i++) {
+      orders[playerNum-1][i] = choice[i] - '1';
+    }
+    screen << RESET << "\n";
+    screen.setMuted(quietMode);
+    orderChosen();
+  }
+  /*isValidOrder
+  Purpose: verifying if the user's order entry is valid
+  Parameter: user's input
+  Return: true if valid, false if invalid
+  */
+  bool isValidOrder(const string &order) {
+    if (order.length() != 4) { //input is not a 4-digit entry
+      screen << "Invalid order choice. Please enter a 4-digit number: ";
+      return false;
+    }
+    bool usedDigits[5] = {false, false, false, false, false}; //1-index array that determines if a given digit has already appeared in the order choice; helps catch entries like 1134
+    for (int i=0; i<4; i++) {
+      if (order.at(i) < '1' || order.at(i) > '4') { //input contains characters that are not 1, 2, 3, or 4
+        screen << "Invalid order choice. Please enter a number consisting of only the digits 1-4: ";
+        return false;
+      }
+      int digit = order.at(i) - '0';
+      if (usedDigits[digit]) { //if a digit appears in the input, the corresponding array position will be set to true; if the position is already set to true, then it means a duplicate digit was used
+        screen << "Invalid order choice. Please use each of the digits 1-4 exactly once: ";
+        return false;
+      }
+      usedDigits[digit] = true; //if the current digit was valid, set its value in the usedDigits array to be true
+    }
+    return true; //false has not yet been returned, so return true
+  }
+
+  /*orderChosen
+  Purpose: asking P2 after P1, or finishing the battle once both orders are in
+  */
+  void orderChosen() {
+    if (playerNum == 1) {
+      askOrder(2);
+    }
+    else {
+      finishBattle();
+    }
+  }
+
+  /*finishBattle
+  Purpose: determining and displaying the battle's results, then either announcing the war's winner or moving on to the next battle
+  */
+  void finishBattle() {
+    screen.setMuted(quietMode);
+    screen << "~ BATTLE " << game.battleNum << " RESULTS ~" << "\n";
+    compareCards(orders[0], orders[1]);
+    screen.setMuted(false);
+    screen.flush(); //the whole battle is written at once
+    INSTRUMENT_VALUE(INSTRUMENT_BATTLE_NS, chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - battleStart).count());
+    if (game.warWinner != 0) { //a player has fewer than 4 cards and loses; the session has already scored the war
+      displayWarWinner();
+      return;
+    }
+    if (showOdds) {
+      printOdds();
+    }
+    pressEnter(NEXT_BATTLE, "BEGIN THE NEXT BATTLE");
+  }
+
+  /*printOdds
+  Purpose: showing each player's chance of winning the war from the current piles (only with --odds); a human is assumed to play like the random policy
+  */
+  void printOdds() {
+    const Player &p1 = game.player(1), &p2 = game.player(2);
+    OrderPolicy p1_policy = p1.isComputer() ? POLICIES[p1.policy].policy : randomOrder;
+    OrderPolicy p2_policy = p2.isComputer() ? POLICIES[p2.policy].policy : randomOrder;
+    AnalysisOptions options; //small limits so the answer is instant: exact only near the end of a war, otherwise 2000 sampled games
+    options.cacheBytes = 1 << 20;
+    options.maxBranches = 20000;
+    options.maxExpansions = 2000;
+    options.samples = 2000;
+    options.seed = game.rng.next();
+    AnalysisResult odds = analyzePosition(positionFromPiles(p1.cards.deck, p1.cards.discard, p2.cards.deck, p2.cards.discard), p1_policy, p2_policy, options);
+    screen << "Chances of winning this war " << (odds.exact ? "(exact): " : "(estimated): ");
+    screen << colours[0][p1.colour] << "P1 " << (int)round(100 * odds.p1Win) << "%" << RESET << ", ";
+    screen << colours[0][p2.colour] << "P2 " << (int)round(100 * odds.p2Win) << "%" << RESET << "\n" << "\n";
+  }
+
+  /*displayWarWinner
+  Purpose: printing congratulatory message to the war winner (the updated scores follow after ENTER)
+  */
+  void displayWarWinner() {
+    const Player &winner = game.player(game.warWinner);
+    screen << "\n" << BLACKTEXT << WHITEHL << " * * * WE HAVE A WINNER! * * * " << RESET << "\n" << "\n";
+    screen << colours[1][winner.colour] << winner.name << " wins WAR " << game.warNum << "! Congratulations!" << RESET << "\n";
+    if (game.recordFailed) {
+      screen << "(This war could not be saved to the record file yet: " << strerror(game.recordWriter->error()) << ")" << "\n";
+    }
+    pressEnter(SCORES, "SEE UPDATED SCORES");
+  }
+
+  /*answerAgain
+  Purpose: determining if the players wish to start a new game of war (and only accept valid entries)
+  Parameters: the players' entry
+  */
+  void answerAgain(const string &againChoice) {
+    if (againChoice.empty()) {
+      return;
+    }
+    if (againChoice == "NO") {
+      screen << "\n";
+      gameConclusion();
+      state = FINISHED;
+    }
+    else if (againChoice == "YES") {
+      screen << "\n";
+      startWar();
+    }
+    else {
+      screen << "Invalid input. Please enter either YES or NO (match text exactly): ";
+    }
+  }
+
+  /*gameConclusion
+  Purpose: printing final results, determining overall winner, thanking user and saying goodbye
+  */
+  void gameConclusion() {
+    const Player &p1 = game.player(1), &p2 = game.player(2);
+    screen << BLACKTEXT << WHITEHL << " * * * FINAL RESULTS * * * " << RESET << "\n" << "\n";
+    //Determining which player won by comparing their scores
+    if (p1.score > p2.score) {
+      screen << colours[1][p1.colour] << p1.name << " IS THE OVERALL WINNER!" << RESET << "\n";
+    }
+    else if (p2.score > p1.score) {
+      screen << colours[1][p2.colour] << p2.name << " IS THE OVERALL WINNER!" << RESET << "\n";
+    }
+    else {
+      screen << BLACKTEXT << WHITEHL << "IT'S A TIE! " << WHITETEXT << colours[1][p1.colour] << p1.name << BLACKTEXT << WHITEHL << " and " << WHITETEXT << colours[1][p2.colour] << p2.name << BLACKTEXT << WHITEHL << ", well done to both of you!" << RESET << "\n";
+    }
+    screen << "\n" << "Hope you enjoyed playing the War Game!" << "\n" << "\n";
+    printWithCircles("Goodbye! :)");
+  }
+};
+
+/*simulateGames
+Purpose: running the headless engine from the command line and printing aggregate win/length statistics (no prompts, no colours)
+Parameters: command-line arguments after "--simulate": game count, seed, optionally the P1 and P2 policy names, and optionally "--record <file>" to append every game to a record file
+Return: exit code for main
 */
-void welcome() {
-  printWithCircles("Welcome to the War Game !");
-  //Game instructions
-  pressEnter("READ THE GAME INSTRUCTIONS");
-  cout << "War is a 2 player card game played with a standard 52-card deck. The goal of both players (" << BLACKTEXT << WHITEHL << "P1" << RESET << " and " << BLACKTEXT << WHITEHL << "P2" << RESET << ") is to win all 52 cards by winning battles." << endl;
-  pressEnter("CONTINUE");
-  cout << "To start, the deck is shuffled and divided evenly among the 2 players (26 cards in each deck). In each battle, both players will draw the top 4 cards from their deck, look at them, and choose the order to play them in. The 4 cards drawn will be labelled 1, 2, 3, and 4. To select an order, you must enter a 4-digit sequence with each of these digits appearing exactly once (e.g. 1234, 3412, 4123, etc.)." << endl;
-  pressEnter("CONTINUE");
-  cout << "Once each player has chosen the order their cards will be played, their cards are compared one-on-one in this order. In each of these 4 sub-battles, the player with the stronger card wins and adds both the card they played and the other player’s losing card to their discard pile." << endl << endl;
-  cout << "The stronger card is the one with the higher face value: " << BLACKTEXT << WHITEHL << "Ace > King > Queen > Jack > Ten > Nine > Eight > Seven > Six > Five > Four > Three > Deuce" << RESET << ". If two cards have the same face value, then the stronger card is the one with the higher suit value: " << BLACKTEXT << WHITEHL << "Clubs > Diamonds > Hearts > Spades" << RESET << "." << endl;
-  pressEnter("CONTINUE");
-  cout << "P1 and P2 continue battling repeatedly. If a player is unable to draw 4 cards from their deck, their discard pile is shuffled into their deck. However, if a player is unable to draw 4 cards from their deck even with the discard pile added in (i.e. they have fewer than 4 cards in total), then they LOSE." << endl << endl << "At the end of a game of War, the winner will earn 100 points. Then, you may choose to have a rematch by playing again!" << endl;
-  pressEnter("BEGIN");
-
-  //Collecting P1 info:
-  cout << "P1 - Please enter your name: ";
-  getline(cin, p1_name); //getline is used instead of cin to catch the player's entire name, in case they enter more than one word
-  cout << endl << "Nice to meet you, " << p1_name << "! :)" << endl;
-  p1_colour = getColourChoice("");  
-  //Collecting P2 info:
-  cout << "P2 - Please enter your name: ";
-  getline(cin, p2_name); 
-  cout << endl << "Nice to meet you, " << p2_name << "! :)" << endl;
-  p2_colour = getColourChoice("DIFFERENT ");
-
-  cout << BLACKTEXT << WHITEHL << "Great! And now... it's time to play War!" << RESET << endl;
-  cout << endl << colours[1][p1_colour] << p1_name << RESET <<" and " << colours[1][p2_colour] << p2_name << RESET << ", ARE YOU READY?" << RESET << endl;
-  pressEnter("PLAY");
+int simulateGames(int argc, char *argv[]) {
+  const char *recordPath = nullptr;
+  if (argc >= 2 && strcmp(argv[argc-2], "--record") == 0) {
+    recordPath = argv[argc-1];
+    argc -= 2;
+  }
+  if (argc < 2) {
+    cout << "Usage: wargame --simulate <games> <seed> [P1 policy] [P2 policy] [--record <file>]" << endl;
+    cout << "Policies:";
+    for (int i=0; i<NUM_POLICIES; i++) {
+      cout << " " << POLICIES[i].name;
+    }
+    cout << endl;
+    return 1;
+  }
+  long long games = atoll(argv[0]);
+  unsigned long long seed = strtoull(argv[1], nullptr, 10);
+  const char *p1_policyName = argc > 2 ? argv[2] : "random";
+  const char *p2_policyName = argc > 3 ? argv[3] : "random";
+  OrderPolicy p1_policy = findPolicy(p1_policyName);
+  OrderPolicy p2_policy = findPolicy(p2_policyName);
+  if (games <= 0 || p1_policy == nullptr || p2_policy == nullptr) {
+    cout << "Invalid game count or policy name." << endl;
+    return 1;
+  }
+
+  RecordWriter writer;
+  if (recordPath != nullptr && !writer.open(recordPath)) {
+    cout << "Cannot open record file: " << recordPath << endl;
+    return 1;
+  }
+
+  auto start = chrono::steady_clock::now();
+  SimStats stats;
+  if (recordPath != nullptr) {
+    stats = runSimulationRecorded(games, seed, p1_policy, p2_policy, SIM_DEFAULT_MAX_BATTLES, writer);
+    if (!writer.close()) {
+      cout << "Cannot write record file " << recordPath << ": " << strerror(writer.error()) << endl;
+      return 1;
+    }
+  }
+  else {
+    stats = runSimulation(games, seed, p1_policy, p2_policy);
+  }
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  cout << "Games: " << stats.games << " (" << p1_policyName << " vs " << p2_policyName << ", seed " << seed << ")" << "\n";
+  cout << "P1 wins: " << stats.p1Wins << " (" << 100.0 * stats.p1Wins / stats.games << "%)" << "\n";
+  cout << "P2 wins: " << stats.p2Wins << " (" << 100.0 * stats.p2Wins / stats.games << "%)" << "\n";
+  cout << "Unfinished after " << SIM_DEFAULT_MAX_BATTLES << " battles: " << stats.unfinished << "\n";
+  cout << "Battles per game: mean " << stats.meanBattles() << ", min " << stats.minBattles << ", median " << stats.percentileBattles(0.5) << ", p99 " << stats.percentileBattles(0.99) << ", max " << stats.maxBattles << "\n";
+  cout << "Reshuffles per game: " << (double)stats.totalReshuffles / stats.games << "\n";
+  cout << "Time: " << seconds << " s (" << stats.games / seconds << " games/s)" << endl;
+  if (INSTRUMENT_ENABLED) {
+    cout << "\n" << instrumentSummary() << flush;
+  }
+  return 0;
 }
 
-/*shuffle
-Purpose: shuffling the card elements in a given deck
-Parameters: deck that is to be shuffled
-Return: shuffled deck (a vector of pair<string, string>)
+/*runTournamentMode
+Purpose: playing every pairing of a list of policies on all cores and printing the P1 win-rate matrix and game lengths per pairing
+Parameters: command-line arguments after "--tournament": games per pairing, seed, and optionally the thread count and the policy names
+Return: exit code for main
 */
-vector < pair<string, string> > shuffle(vector < pair<string, string> > deck) {
-  //Create a copy of the inputted deck; the shuffled deck will be created by repeatedly randomly removing cards from the copy and populating the shuffled deck with the removed cards
-  vector < pair<string, string> > copyDeck(deck);
-  vector < pair<string, string> > shuffledDeck;
-  srand(time(0)); //use time(0) to set a random seed
-  while (copyDeck.size() > 0) {
-    int removeCard = rand()%copyDeck.size(); //randomly generated index of card to be removed
-    shuffledDeck.push_back(copyDeck[removeCard]); //add this card to shuffledDeck
-    copyDeck.erase(copyDeck.begin() + removeCard); //erase this card from copyDeck to avoid drawing the same card twice
-  }
-  return shuffledDeck;  
+int runTournamentMode(int argc, char *argv[]) {
+  if (argc < 2) {
+    cout << "Usage: wargame --tournament <games per pairing> <seed> [threads] [policy ...]" << endl;
+    return 1;
+  }
+  long long gamesPerPairing = atoll(argv[0]);
+  unsigned long long seed = strtoull(argv[1], nullptr, 10);
+  int numThreads = argc > 2 ? atoi(argv[2]) : 0;
+  if (numThreads <= 0) {
+    numThreads = defaultThreadCount();
+  }
+  vector <int> policies;
+  for (int i=3; i<argc; i++) {
+    int policy = findPolicyIndex(argv[i]);
+    if (policy == -1) {
+      cout << "Unknown policy: " << argv[i] << endl;
+      return 1;
+    }
+    policies.push_back(policy);
+  }
+  if (policies.empty()) { //no policies listed: use all of them
+    for (int j=0; j<NUM_POLICIES; j++) {
+      policies.push_back(j);
+    }
+  }
+  if (gamesPerPairing <= 0) {
+    cout << "Invalid game count." << endl;
+    return 1;
+  }
+
+  auto start = chrono::steady_clock::now();
+  TournamentResult result = runTournament(policies, gamesPerPairing, seed, numThreads);
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  int n = policies.size();
+  cout << "P1 win rate (%), rows = P1 policy, columns = P2 policy" << "\n" << setw(12) << "";
+  for (int j=0; j<n; j++) {
+    cout << setw(12) << POLICIES[policies[j]].name;
+  }
+  cout << "\n" << fixed << setprecision(2);
+  for (int i=0; i<n; i++) {
+    cout << setw(12) << POLICIES[policies[i]].name;
+    for (int j=0; j<n; j++) {
+      const SimStats &stats = result.pairing(i, j);
+      cout << setw(12) << 100.0 * stats.p1Wins / stats.games;
+    }
+    cout << "\n";
+  }
+  cout << "\n" << "Game length (battles)" << "\n";
+  cout << setw(25) << "pairing" << setw(10) << "mean" << setw(8) << "p50" << setw(8) << "p90" << setw(8) << "p99" << setw(8) << "max" << setw(12) << "unfinished" << "\n";
+  for (int i=0; i<n; i++) {
+    for (int j=0; j<n; j++) {
+      const SimStats &stats = result.pairing(i, j);
+      cout << setw(25) << (string(POLICIES[policies[i]].name) + " vs " + POLICIES[policies[j]].name) << setw(10) << stats.meanBattles();
+      cout << setw(8) << stats.percentileBattles(0.5) << setw(8) << stats.percentileBattles(0.9) << setw(8) << stats.percentileBattles(0.99) << setw(8) << stats.maxBattles << setw(12) << stats.unfinished << "\n";
+    }
+  }
+  long long totalGames = gamesPerPairing * n * n;
+  cout << "\n" << totalGames << " games on " << numThreads << " threads in " << seconds << " s (" << setprecision(0) << totalGames / seconds << " games/s)" << endl;
+  if (INSTRUMENT_ENABLED) {
+    cout << "\n" << instrumentSummary() << flush;
+  }
+  return 0;
 }
-/*resetGame
-Purpose: clear all card piles and redistribute the 52 cards evenly and randomly among the 2 players
+
+//Replay observer that prints a recorded game battle by battle
+struct ReplayPrinter {
+  void reshuffled(int playerNum, const CardPile &newDeck) {
+    cout << "P" << playerNum << " - Shuffling discard pile (" << newDeck.size() << " cards)" << "\n";
+  }
+  void battle(int battleNum, const Card currentHands[2][4], const unsigned char *p1_order, const unsigned char *p2_order) {
+    cout << "BATTLE " << battleNum << "\n";
+    for (int i=0; i<4; i++) {
+      Card p1_card = currentHands[0][p1_order[i]];
+      Card p2_card = currentHands[1][p2_order[i]];
+      cout << "  " << cardName(p1_card) << " vs " << cardName(p2_card) << ": P" << (p1_card > p2_card ? 1 : 2) << " wins" << "\n";
+    }
+  }
+};
+
+/*replayGames
+Purpose: replaying every game of a record file to check it, and optionally printing one of the games
+Parameters: command-line arguments after "--replay": record file, and optionally the number of the game to print (counting from 1)
+Return: exit code for main (0 if every record is valid)
 */
-void resetGame() {
-  //Clear all card piles
-  p1_deck.clear();
-  p1_discard.clear();
-  p2_deck.clear();
-  p2_discard.clear();
-  //Creating p1_deck and p2_deck by shuffling the original deck and splitting it in half
-    vector < pair<string, string> > shuffledDeck = shuffle(originalDeck);
-    for (int i=0; i<26; i++) {
-      p1_deck.push_back(shuffledDeck[i]); //add the first half of the deck to p1_deck
-    }
-    for (int i=26; i<52; i++) {
-      p2_deck.push_back(shuffledDeck[i]); //add the other half of the deck to p2_deck
+int replayGames(int argc, char *argv[]) {
+  if (argc < 1) {
+    cout << "Usage: wargame --replay <file> [game number]" << endl;
+    return 1;
+  }
+  RecordFile file;
+  if (!file.open(argv[0])) {
+    cout << "Cannot read record file: " << argv[0] << endl;
+    return 1;
+  }
+  long long gameToPrint = argc > 1 ? atoll(argv[1]) : 0;
+
+  auto start = chrono::steady_clock::now();
+  long long games = 0, totalBattles = 0;
+  long long statusCounts[5] = {};
+  size_t offset = file.firstOffset();
+  GameRecord record;
+  bool truncated = false;
+  while (file.read(offset, record, truncated)) {
+    games++;
+    totalBattles += record.battles;
+    ReplayStatus status;
+    if (games == gameToPrint) {
+      cout << "Game " << games << " (seed " << record.seed << ", stream " << record.stream << ")" << "\n";
+      ReplayPrinter printer;
+      status = replayGame(record, printer);
+      cout << (record.winner == 0 ? "Abandoned" : (record.winner == 1 ? "P1 wins" : "P2 wins")) << " after " << record.battles << " battles" << "\n" << "\n";
+    }
+    else {
+      status = replayGame(record);
     }
+    statusCounts[status]++;
+  }
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  cout << "Games: " << games << " (" << file.fileSize() << " bytes, " << (games > 0 ? (double)file.fileSize() / games : 0) << " bytes per game)" << "\n";
+  for (int s=0; s<5; s++) {
+    if (statusCounts[s] > 0) {
+      cout << REPLAY_STATUS_NAMES[s] << ": " << statusCounts[s] << "\n";
+    }
+  }
+  if (truncated) {
+    cout << "The last record is cut short." << "\n";
+  }
+  cout << "Time: " << seconds << " s (" << games / seconds << " games/s, " << totalBattles / seconds << " battles/s)" << endl;
+  return (statusCounts[REPLAY_OK] == games && !truncated) ? 0 : 1;
 }
-/*isValidOrder
-Purpose: verifying if the user's order entry is valid
-Parameter: user's input
-Return: true if valid, false if invalid
+
+/*parsePile
+Purpose: reading a pile from the command line: short card names separated by commas (e.g. "AS,10H,2C"), "-" for an empty pile, or "rest" for every card not in another pile
+Parameters: the text, set that receives the cards, flag set if the pile is "rest"
+Return: false if a card name is invalid
 */
-bool isValidOrder(string order) {
-  if (order.length() != 4) { //input is not a 4-digit entry
-    cout << "Invalid order choice. Please enter a 4-digit number: ";
-    return false;
-  }
-  bool usedDigits[5] = {false, false, false, false, false}; //1-index array that determines if a given digit has already appeared in the order choice; helps catch entries like 1134
-  for (int i=0; i<4; i++) {
-    if (!isdigit(order.at(i)) || stoi(order.substr(i,1)) > 4 || stoi(order.substr(i,1)) < 1) { //input contains characters that are not 1, 2, 3, or 4
-      cout << "Invalid order choice. Please enter a number consisting of only the digits 1-4: ";
-      return false;
+bool parsePile(const string &text, uint64_t &bits, bool &isRest) {
+  bits = 0;
+  isRest = text == "rest";
+  if (isRest || text == "-") {
+    return true;
+  }
+  size_t start = 0;
+  while (start <= text.size()) {
+    size_t end = text.find(',', start);
+    if (end == string::npos) {
+      end = text.size();
     }
-    if (usedDigits[stoi(order.substr(i,1))]) { //if a digit appears in the input, the corresponding array position will be set to true; if the position is already set to true, then it means a duplicate digit was used
-      cout << "Invalid order choice. Please use each of the digits 1-4 exactly once: ";
+    int card = parseCard(text.substr(start, end - start));
+    if (card == -1) {
+      cout << "Invalid card: " << text.substr(start, end - start) << endl;
       return false;
     }
-    usedDigits[stoi(order.substr(i,1))] = true; //if the current digit was valid, set its value in the usedDigits array to be true
+    bits |= 1ULL << card;
+    start = end + 1;
   }
-  return true; //false has not yet been returned, so return true
+  return true;
 }
-/*getOrderChoice
-Purpose: displaying the user's 4 cards, prompting for their order choice, error-trapping to ensure the entry is a permutation of 1234
-Parameters: int that is the player number (to access the correct information), 2D array of pair<string,string> containing both players' current hands
-Return: string that is the player's valid order choice
+
+/*analyzeMode
+Purpose: printing each player's chance of winning and the expected battles left from a position given on the command line
+Parameters: command-line arguments after "--analyze": both policies, the four piles (see parsePile), and optionally the AnalysisOptions --horizon, --samples, --cache-mb, --max-branches and --max-positions
+Return: exit code for main
 */
-string getOrderChoice(int playerNum, pair<string, string> currentHands[2][4]) {
-  //Displaying with the correct highlight colour
-  if (playerNum == 1) {
-    cout << colours[1][p1_colour]; 
+int analyzeMode(int argc, char *argv[]) {
+  if (argc < 6) {
+    cout << "Usage: wargame --analyze <P1 policy> <P2 policy> <P1 deck> <P1 discard> <P2 deck> <P2 discard> [--horizon N] [--samples N] [--cache-mb N] [--max-branches N] [--max-positions N]" << endl;
+    cout << "Piles: short card names separated by commas (e.g. AS,10H,2C), - for an empty pile, or rest for all the other cards" << endl;
+    return 1;
   }
-  else {
-    cout << colours[1][p2_colour];
+  OrderPolicy p1_policy = findPolicy(argv[0]);
+  OrderPolicy p2_policy = findPolicy(argv[1]);
+  if (p1_policy == nullptr || p2_policy == nullptr) {
+    cout << "Unknown policy name." << endl;
+    return 1;
   }
-  cout << "P" << playerNum << " - Here are your 4 cards:" << RESET << endl;
-  //Loop through the corresponding currentHands array to output the 4 top cards
-  for (int i=0; i<4; i++) {
-    cout << i+1 << ". " << currentHands[playerNum-1][i].first << " of " << currentHands[playerNum-1][i].second << endl;    
+  uint64_t piles[4];
+  int restPile = -1;
+  for (int p=0; p<4; p++) {
+    bool isRest;
+    if (!parsePile(argv[2+p], piles[p], isRest)) {
+      return 1;
+    }
+    if (isRest) {
+      restPile = p;
+    }
   }
-  //Displaying with the correct text colour
-  if (playerNum == 1) {
-    cout << colours[0][p1_colour]; 
+  if (restPile != -1) {
+    piles[restPile] = ((1ULL << NUM_CARDS) - 1) & ~(piles[0] | piles[1] | piles[2] | piles[3]);
   }
-  else {
-    cout << colours[0][p2_colour];
+  Position position = {piles[0], piles[1], piles[2], piles[3]};
+  if (!isValidPosition(position)) {
+    cout << "Every card must be in exactly one pile." << endl;
+    return 1;
   }
-  cout << "Enter the order you would like to play your cards in (enter the corresponding 4-digit number): ";
-  string choice;
-  bool validChoice = true;
-  do {
-    cin >> choice;
-    if (!isValidOrder(choice)) { //invalid choice, keep looping
-      validChoice = false;
+  AnalysisOptions options;
+  for (int i=6; i+1<argc; i+=2) {
+    if (strcmp(argv[i], "--horizon") == 0) {
+      options.horizon = atoi(argv[i+1]);
+    }
+    else if (strcmp(argv[i], "--samples") == 0) {
+      options.samples = atoll(argv[i+1]);
+    }
+    else if (strcmp(argv[i], "--cache-mb") == 0) {
+      options.cacheBytes = (size_t)atoll(argv[i+1]) << 20;
     }
-    else { //valid order choice
-      break;
+    else if (strcmp(argv[i], "--max-branches") == 0) {
+      options.maxBranches = atoll(argv[i+1]);
     }
+    else if (strcmp(argv[i], "--max-positions") == 0) {
+      options.maxExpansions = atoll(argv[i+1]);
+    }
+  }
+  if (options.horizon <= 0 || options.samples <= 0) {
+    cout << "Invalid horizon or sample count." << endl;
+    return 1;
+  }
+
+  auto start = chrono::steady_clock::now();
+  AnalysisResult result = analyzePosition(position, p1_policy, p2_policy, options);
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  cout << "P1: " << position.p1Cards() << " cards (" << __builtin_popcountll(position.p1Deck) << " in deck), P2: " << position.p2Cards() << " cards (" << __builtin_popcountll(position.p2Deck) << " in deck)" << "\n";
+  if (result.exact) {
+    cout << "Exact, within " << options.horizon << " battles:" << "\n";
+    cout << "P1 wins: " << 100 * result.p1Win << "%" << "\n";
+    cout << "P2 wins: " << 100 * result.p2Win << "%" << "\n";
+    cout << "Still going after " << options.horizon << " battles: " << 100 * result.unfinished << "%" << "\n";
+    cout << "Expected battles (counting at most " << options.horizon << "): " << result.battles << "\n";
+  }
+  else {
+    cout << "Too large for the exact search; estimated from " << result.samples << " games:" << "\n";
+    cout << "P1 wins: " << 100 * result.p1Win << "% (+/- " << 100 * result.p1WinError << ")" << "\n";
+    cout << "P2 wins: " << 100 * result.p2Win << "%" << "\n";
+    cout << "Unfinished after " << ANALYZER_MAX_BATTLES << " battles: " << 100 * result.unfinished << "%" << "\n";
+    cout << "Expected battles left: " << result.battles << " (+/- " << result.battlesError << ")" << "\n";
   }
-  while (!validChoice);
-  cout << RESET << endl;
-  return choice;
+  cout << "Positions expanded: " << result.expansions << ", cache hits " << result.cacheHits << ", misses " << result.cacheMisses << ", evictions " << result.cacheEvictions << " (" << (result.cacheBytes >> 20) << " MB)" << "\n";
+  cout << "Time: " << seconds << " s" << endl;
+  return 0;
 }
-/*compareCards
-Purpose: comparing each pairing of cards for the 4 sub-battles in each battle
-Parameter: both players' order choices, stored in a 2D pair<string,string> (representing face&suit) array
+
+/*simulateVariant
+Purpose: playing a batch of games of one rule variant and printing the wins per seat and the game lengths
+Parameters: name of the variant, game count, seed, policy names for the first seats (the other seats play random)
+Return: exit code for main
 */
-void compareCards(pair<string, string> orderChoices[2][4]) {
-  for (int i=0; i<4; i++) { //loop 4 times to cover all sub-battles
-    if (convertFaces[orderChoices[0][i].first] > convertFaces[orderChoices[1][i].first]) { //P1's card has a larger face
-      //p1_discard gains both cards
-      p1_discard.push_back(orderChoices[0][i]);
-      p1_discard.push_back(orderChoices[1][i]);
-      cout << colours[0][p1_colour] << "Sub-battle " << i+1 << ": P1 wins with " << orderChoices[0][i].first << " of " << orderChoices[0][i].second;
-    }
-    else if (convertFaces[orderChoices[0][i].first] < convertFaces[orderChoices[1][i].first]) { //P2's card has a larger face
-      //p2_discard gains both cards
-      p2_discard.push_back(orderChoices[0][i]);
-      p2_discard.push_back(orderChoices[1][i]);
-      cout << colours[0][p2_colour] << "Sub-battle " << i+1 << ": P2 wins with " << orderChoices[1][i].first << " of " << orderChoices[1][i].second;
-    }
-    else { //matching faces → suit tiebreaker
-      if (convertSuits[orderChoices[0][i].second] > convertSuits[orderChoices[1][i].second]) { //P1's card has a larger suit
-        //p1_discard gains both cards
-        p1_discard.push_back(orderChoices[0][i]);
-        p1_discard.push_back(orderChoices[1][i]);
-        cout << colours[0][p1_colour] << "Sub-battle " << i+1 << ": P1 wins with " << orderChoices[0][i].first << " of " << orderChoices[0][i].second;
-      }
-      else { //P2's card has a larger suit
-        //p2_discard gains both cards
-        p2_discard.push_back(orderChoices[0][i]);
-        p2_discard.push_back(orderChoices[1][i]);
-        cout << colours[0][p2_colour] << "Sub-battle " << i+1 << ": P2 wins with " << orderChoices[1][i].first << " of " << orderChoices[1][i].second;
-      }
+template <typename Rules>
+int simulateVariant(const char *variantName, long long games, uint64_t seed, int numPolicyNames, char *policyNames[]) {
+  VariantPolicy<Rules> policies[Rules::NUM_PLAYERS];
+  string pairing;
+  for (int p=0; p<Rules::NUM_PLAYERS; p++) {
+    const char *policyName = p < numPolicyNames ? policyNames[p] : "random";
+    policies[p] = findVariantPolicy<Rules>(policyName);
+    if (policies[p] == nullptr) {
+      cout << "Unknown policy for this variant: " << policyName << " (fixed, random, ascending, descending or greedy)" << endl;
+      return 1;
     }
-    cout << RESET << endl;
-  }  
+    pairing += (p == 0 ? "" : " vs ") + string(policyName);
+  }
+
+  auto start = chrono::steady_clock::now();
+  VariantStats<Rules> stats = runVariantSimulation<Rules>(games, seed, policies);
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  cout << "Variant: " << variantName << " (" << Rules::NUM_PLAYERS << " players, hand of " << Rules::HAND_SIZE << ", " << Rules::DECK_SIZE << " cards, " << Rules::DEAL_SIZE << " dealt to each player)" << "\n";
+  cout << "Games: " << stats.games() << " (" << pairing << ", seed " << seed << ")" << "\n";
+  for (int p=0; p<Rules::NUM_PLAYERS; p++) {
+    cout << "P" << p+1 << " wins: " << stats.wins[p] << " (" << 100.0 * stats.wins[p] / stats.games() << "%)" << "\n";
+  }
+  const SimStats &lengths = stats.lengths;
+  cout << "Unfinished after " << SIM_DEFAULT_MAX_BATTLES << " battles: " << stats.unfinished << "\n";
+  cout << "Battles per game: mean " << lengths.meanBattles() << ", min " << lengths.minBattles << ", median " << lengths.percentileBattles(0.5) << ", p99 " << lengths.percentileBattles(0.99) << ", max " << lengths.maxBattles << "\n";
+  cout << "Reshuffles per game: " << (double)lengths.totalReshuffles / lengths.games << "\n";
+  cout << "Time: " << seconds << " s (" << lengths.games / seconds << " games/s)" << endl;
+  return 0;
 }
-/*battle
-Purpose: executing the battle
-Parameter: battle number
+
+//Rule variants that can be simulated by name; each one is compiled separately (see variant.h)
+struct NamedVariant {
+  const char *name;
+  int (*simulate)(const char *variantName, long long games, uint64_t seed, int numPolicyNames, char *policyNames[]);
+};
+
+const NamedVariant VARIANTS[] = {
+  {"classic", simulateVariant< WarRules<4, 2> >},
+  {"hand-3", simulateVariant< WarRules<3, 2> >},
+  {"hand-5", simulateVariant< WarRules<5, 2> >},
+  {"hand-6", simulateVariant< WarRules<6, 2> >},
+  {"piquet", simulateVariant< WarRules<4, 2, 1, 5> >}, //32 cards, Seven to Ace
+  {"2-deck", simulateVariant< WarRules<4, 2, 2> >},
+  {"3-player", simulateVariant< WarRules<4, 3> >},
+  {"4-player", simulateVariant< WarRules<4, 4> >},
+  {"5-player", simulateVariant< WarRules<4, 5> >},
+  {"6-player", simulateVariant< WarRules<4, 6, 2> >} //2 decks, so everyone starts with 17 cards
+};
+const int NUM_VARIANTS = sizeof(VARIANTS) / sizeof(VARIANTS[0]);
+
+/*variantMode
+Purpose: simulating a rule variant chosen by name from the command line
+Parameters: command-line arguments after "--variant": variant name, game count, seed, and optionally a policy name for each seat
+Return: exit code for main
 */
-void battle(int battleNum) {  
-  cout << BLACKTEXT << WHITEHL << " * * * BATTLE " << battleNum <<" * * * " <<RESET << endl;
-  //Shuffle in cards if the deck size is below 4
-  if (p1_deck.size() < 4) {
-    cout << colours[1][p1_colour] << "P1 - Shuffling discard pile..." << RESET << endl;
-    //add any leftover cards from p1_deck to the discard pile
-    p1_discard.insert(p1_discard.end(), p1_deck.begin(), p1_deck.end()); 
-    //place the shuffled discard pile in p1_deck and clear the discard pile
-    p1_deck = shuffle(p1_discard);
-    p1_discard.clear();
-  }
-  if (p2_deck.size() < 4) {
-    cout << colours[1][p2_colour] << "P2 - Shuffling discard pile..." << RESET << endl;
-    p2_discard.insert(p2_discard.end(), p2_deck.begin(), p2_deck.end()); 
-    p2_deck = shuffle(p2_discard);
-    p2_discard.clear();
-  }
-  //Display the size of each player's deck and discard piles
-  cout << endl << "~ CURRENT CARD COUNT ~" << endl;
-  cout << colours[0][p1_colour] << "P1 deck: " << p1_deck.size() << " cards" << endl;
-  cout << "P1 discard: " << p1_discard.size() << " cards" << RESET << endl;
-  cout << colours[0][p2_colour] << "P2 deck: " << p2_deck.size() << " cards" << endl;
-  cout << "P2 discard: " << p2_discard.size() << " cards" << RESET << endl << endl;
-  
-  //Select the top 4 cards from each player's deck - these are their current hands
-  pair<string, string> currentHands[2][4] = {
-    {p1_deck[0], p1_deck[1], p1_deck[2], p1_deck[3]}, 
-    {p2_deck[0], p2_deck[1], p2_deck[2], p2_deck[3]}
-    };
-  //Remove these cards from their respective decks
-  p1_deck.erase(p1_deck.begin(), p1_deck.begin()+4);
-  p2_deck.erase(p2_deck.begin(), p2_deck.begin()+4);
-  //Get the players' order choices (for how they wish to play their four cards)
-  string p1_orderChoice = getOrderChoice(1, currentHands);
-  string p2_orderChoice = getOrderChoice(2, currentHands);
-  //Place chosen order of cards into a new 2D array
-  pair<string, string> orderChoices[2][4]; 
-  for (int i=0; i<4; i++) { 
-    orderChoices[0][i] = currentHands[0][stoi(p1_orderChoice.substr(i,1))-1];
-    orderChoices[1][i] = currentHands[1][stoi(p2_orderChoice.substr(i,1))-1];
-  }  
-  //Determine and display results
-  cout << "~ BATTLE " << battleNum << " RESULTS ~" << endl;
-  compareCards(orderChoices);
-  string empty;
-  getline(cin, empty);
+int variantMode(int argc, char *argv[]) {
+  const NamedVariant *variant = nullptr;
+  for (int i=0; i<NUM_VARIANTS && argc > 0; i++) {
+    if (strcmp(VARIANTS[i].name, argv[0]) == 0) {
+      variant = &VARIANTS[i];
+    }
+  }
+  if (argc < 3 || variant == nullptr) {
+    cout << "Usage: wargame --variant <variant> <games> <seed> [policy for each seat ...]" << endl;
+    cout << "Variants:";
+    for (int i=0; i<NUM_VARIANTS; i++) {
+      cout << " " << VARIANTS[i].name;
+    }
+    cout << endl;
+    return 1;
+  }
+  long long games = atoll(argv[1]);
+  unsigned long long seed = strtoull(argv[2], nullptr, 10);
+  if (games <= 0) {
+    cout << "Invalid game count." << endl;
+    return 1;
+  }
+  return variant->simulate(variant->name, games, seed, argc-3, argv+3);
 }
-/*displayWarWinner
-Purpose: printing congratulatory message to the war winner and printing updated scores
-Parameters: winner's colour choice, name, and the war number
+
+/*printValidationRow
+Purpose: printing one line of the validation table: the tuned policy's and the reference policy's win rates and their difference, with 95% confidence intervals
 */
-void displayWarWinner(int winnerColour, string winnerName, int warNum) {
-  cout << endl << BLACKTEXT << WHITEHL << " * * * WE HAVE A WINNER! * * * " << RESET << endl << endl;
-  cout << colours[1][winnerColour] << winnerName << " wins WAR " << warNum << "! Congratulations!" << RESET << endl;
-  pressEnter("SEE UPDATED SCORES");
-  cout << colours[0][p1_colour] << "P1: " << p1_score << RESET << endl;
-  cout << colours[0][p2_colour] << "P2: " << p2_score << RESET << endl;
+void printValidationRow(const string &label, const ValidationResult &result) {
+  cout << "  " << left << setw(12) << label << right;
+  cout << setw(7) << 100 * result.policy.mean() << "% +/- " << setw(5) << 100 * result.policy.halfWidth() << "%   ";
+  cout << setw(7) << 100 * result.reference.mean() << "% +/- " << setw(5) << 100 * result.reference.halfWidth() << "%   ";
+  cout << showpos << setw(7) << 100 * result.difference.mean() << noshowpos << "% +/- " << setw(5) << 100 * result.difference.halfWidth() << "%" << endl;
 }
-/*getAgainChoice
-Purpose: determining if the players wish to start a new game of war (and only accept valid entries)
-Return: true if "YES", false if "NO"
+
+/*tuneMode
+Purpose: searching for the weights of the weighted policy that win the most against the given opponents on all cores (see tuning.h), then measuring the result on deals the search never played
+Parameters: command-line arguments after "--tune": generations, deals per candidate and opponent, seed, the opponents' policy names, and optionally --population N, --elite N, --threads N, --checkpoint <file>, --validate <deals> and --reference <policy>
+Return: exit code for main
 */
-bool getAgainChoice() {
-  cout << "Would you like to start another game of War? Enter YES or NO (case sensitive): ";
-  string againChoice;
-  bool isValid = true;
-  do {
-    cin >> againChoice;
-    if (againChoice == "NO") {
-      return false;
+int tuneMode(int argc, char *argv[]) {
+  const char *USAGE = "Usage: wargame --tune <generations> <deals per candidate> <seed> <opponent policy> [opponent policy ...] [--population N] [--elite N] [--threads N] [--checkpoint <file>] [--validate <deals>] [--reference <policy>]";
+  if (argc < 4) {
+    cout << USAGE << endl;
+    return 1;
+  }
+  TuningOptions options;
+  options.generations = atoi(argv[0]);
+  options.dealsPerCandidate = atoll(argv[1]);
+  options.seed = strtoull(argv[2], nullptr, 10);
+  options.numThreads = defaultThreadCount();
+  long long validationDeals = 20000;
+  const char *referenceName = "counter";
+  for (int i=3; i<argc; i++) {
+    if (argv[i][0] == '-' && i+1 < argc) {
+      if (strcmp(argv[i], "--population") == 0) {
+        options.population = atoi(argv[i+1]);
+      }
+      else if (strcmp(argv[i], "--elite") == 0) {
+        options.eliteCount = atoi(argv[i+1]);
+      }
+      else if (strcmp(argv[i], "--threads") == 0) {
+        options.numThreads = atoi(argv[i+1]);
+      }
+      else if (strcmp(argv[i], "--checkpoint") == 0) {
+        options.checkpointPath = argv[i+1];
+      }
+      else if (strcmp(argv[i], "--validate") == 0) {
+        validationDeals = atoll(argv[i+1]);
+      }
+      else if (strcmp(argv[i], "--reference") == 0) {
+        referenceName = argv[i+1];
+      }
+      else {
+        cout << USAGE << endl;
+        return 1;
+      }
+      i++;
+      continue;
     }
-    else if (againChoice == "YES") {
-      return true;
+    OrderPolicy opponent = findPolicy(argv[i]);
+    if (opponent == nullptr) {
+      cout << "Unknown policy: " << argv[i] << endl;
+      return 1;
     }
-    else {
-      cout << "Invalid input. Please enter either YES or NO (match text exactly): ";
-      isValid = false;
+    options.opponents.push_back(opponent);
+    options.opponentNames.push_back(argv[i]);
+  }
+  OrderPolicy reference = findPolicy(referenceName);
+  if (reference == nullptr) {
+    cout << "Unknown policy: " << referenceName << endl;
+    return 1;
+  }
+  if (options.opponents.empty() || options.generations <= 0 || options.dealsPerCandidate <= 0 || options.population < 2 || options.eliteCount < 1 || options.numThreads <= 0 || validationDeals <= 0) {
+    cout << USAGE << endl;
+    return 1;
+  }
+
+  TuningState state = startTuning(options);
+  if (!options.checkpointPath.empty()) {
+    ifstream existing(options.checkpointPath);
+    if (existing) { //resume where the last run stopped
+      string error = loadTuning(options, state);
+      if (!error.empty()) {
+        cout << "Cannot resume: " << error << endl;
+        return 1;
+      }
+      cout << "Resuming from " << options.checkpointPath << " after generation " << state.generation << endl;
     }
   }
-  while (!isValid); //continue looping until valid input
-  return true;
+  cout << "Tuning against " << joinNames(options.opponentNames) << ": " << options.population << " candidates x " << options.dealsPerCandidate << " deals x " << options.opponents.size() << (options.opponents.size() == 1 ? " opponent" : " opponents") << " x 2 seats per generation, on " << options.numThreads << " threads" << endl;
+  cout << fixed << setprecision(2);
+  auto start = chrono::steady_clock::now();
+  while (state.generation < options.generations) {
+    auto generationStart = chrono::steady_clock::now();
+    vector <double> winRates = tuningGeneration(options, state);
+    double meanSpread = 0;
+    for (int f=0; f<NUM_POLICY_FEATURES; f++) {
+      meanSpread += state.spread[f] / NUM_POLICY_FEATURES;
+    }
+    cout << "Generation " << setw(3) << state.generation << ": mean weights win " << setw(6) << 100 * winRates[0] << "%, best candidate " << setw(6) << 100 * *max_element(winRates.begin(), winRates.end()) << "%, spread " << setprecision(3) << meanSpread << setprecision(2);
+    cout << " (" << chrono::duration<double>(chrono::steady_clock::now() - generationStart).count() << " s)" << endl;
+    if (!options.checkpointPath.empty() && !saveTuning(options, state)) {
+      cout << "Cannot write the checkpoint " << options.checkpointPath << endl;
+      return 1;
+    }
+  }
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cout << state.gamesPlayed << " games in total, " << setprecision(1) << seconds << " s this run" << endl;
+
+  //The search's answer is the mean of the final Gaussian; the best single candidate was only measured on its own generation's deals, so its win rate is optimistic
+  cout << "\n" << "~ TUNED WEIGHTS ~" << "\n";
+  for (int f=0; f<NUM_POLICY_FEATURES; f++) {
+    cout << "  " << left << setw(24) << POLICY_FEATURE_NAMES[f] << right << setw(8) << setprecision(4) << state.mean[f] << endl;
+  }
+  cout << "As code: {{";
+  for (int f=0; f<NUM_POLICY_FEATURES; f++) {
+    cout << (f > 0 ? ", " : "") << state.mean[f];
+  }
+  cout << "}}" << endl;
+  cout << setprecision(2) << "Best single candidate: " << 100 * state.bestWinRate << "% in generation " << state.bestGeneration + 1 << " (on that generation's deals only)" << endl;
+
+  cout << "\n" << "~ VALIDATION ~" << "\n";
+  cout << validationDeals << " new deals per opponent, each played in both seats; 95% confidence intervals over deals" << endl;
+  vector <ValidationResult> results = validatePolicy(state.mean, reference, options, validationDeals);
+  cout << "  " << left << setw(12) << "opponent" << right << setw(17) << "tuned" << setw(20) << referenceName << setw(20) << string("tuned - ") + referenceName << endl;
+  ValidationResult overall;
+  for (size_t o=0; o<results.size(); o++) {
+    printValidationRow(options.opponentNames[o], results[o]);
+    overall.policy.merge(results[o].policy);
+    overall.reference.merge(results[o].reference);
+    overall.difference.merge(results[o].difference);
+  }
+  if (results.size() > 1) {
+    printValidationRow("overall", overall);
+  }
+  return 0;
 }
-/*gameConclusion
-Purpose: printing final results, determining overall winner, thanking user and saying goodbye
+
+/*serveMode
+Purpose: hosting interactive games for many players at once over a local socket (see server.h), with the same display options as the terminal game
+Parameters: command-line arguments after "--serve": socket path, optionally a seed, then --no-color, --quiet and --record <file> (not --odds: the analysis after every battle would run on the server's one thread and hold up every other game)
+Return: exit code for main
 */
-void gameConclusion() {
-  cout << BLACKTEXT << WHITEHL << " * * * FINAL RESULTS * * * " << RESET << endl << endl;
-  //Determining which player won by comparing their scores
-  if (p1_score > p2_score) {
-    cout << colours[1][p1_colour] << p1_name << " IS THE OVERALL WINNER!" << RESET << endl;
+int serveMode(int argc, char *argv[]) {
+  if (argc < 1) {
+    cout << "Usage: wargame --serve <socket path> [seed] [--no-color] [--quiet] [--record <file>]" << endl;
+    return 1;
   }
-  else if (p2_score > p1_score) {
-    cout << colours[1][p2_colour] << p2_name << " IS THE OVERALL WINNER!" << RESET << endl;
+  int first = 1;
+  unsigned long long seed = time(0);
+  if (argc > 1 && isdigit(argv[1][0])) {
+    seed = strtoull(argv[1], nullptr, 10);
+    first = 2;
   }
-  else {
-    cout << BLACKTEXT << WHITEHL << "IT'S A TIE! " << WHITETEXT << colours[1][p1_colour] << p1_name << BLACKTEXT << WHITEHL << " and " << WHITETEXT << colours[1][p2_colour] << p2_name << BLACKTEXT << WHITEHL << ", well done to both of you!" << RESET << endl;
+  Renderer::Mode mode = Renderer::COLOUR;
+  RecordWriter gameLog; //with --record every war of every game is appended here (the server is one thread, so the writer is never shared between threads)
+  bool recording = false;
+  for (int i=first; i<argc; i++) {
+    if (strcmp(argv[i], "--no-color") == 0) {
+      mode = Renderer::PLAIN;
+    }
+    else if (strcmp(argv[i], "--quiet") == 0) {
+      quietMode = true;
+    }
+    else if (strcmp(argv[i], "--odds") == 0) {
+      cout << "--odds is not available with --serve: the analysis would stall every other game on the server" << endl;
+      return 1;
+    }
+    else if (strcmp(argv[i], "--record") == 0 && i+1 < argc) {
+      i++;
+      if (!gameLog.open(argv[i])) {
+        cout << "Cannot open record file: " << argv[i] << endl;
+        return 1;
+      }
+      recording = true;
+    }
+    else {
+      cout << "Unknown option: " << argv[i] << endl;
+      return 1;
+    }
+  }
+  int exitCode = serveGames<GameFlow>(argv[0], seed, [&](GameFlow &flow) {
+    flow.screen.setMode(mode);
+    if (recording) {
+      flow.game.recordWriter = &gameLog;
+    }
+  });
+  if (recording && !gameLog.close()) {
+    cout << "Cannot write record file: " << strerror(gameLog.error()) << " (the wars not yet written are lost)" << endl;
+    return 1;
   }
-  cout << endl << "Hope you enjoyed playing the War Game!" << endl << endl;
-  printWithCircles("Goodbye! :)");
+  return exitCode;
 }
 
-int main() {
-  setup();
-  welcome(); 
-  bool playAgain = true;
-  int warNum = 0; //to count the number of rounds of War played
-  do {
-    resetGame();
-    warNum++;
-    printWithCircles(("WAR " + to_string(warNum)));
-    cout << endl;
-
-    int p1_totalCards, p2_totalCards;
-    int battleNum = 0;
-    while (true) {
-      battleNum++;
-      battle(battleNum);
-      p1_totalCards = p1_deck.size() + p1_discard.size();
-      p2_totalCards = p2_deck.size() + p2_discard.size();
-      if (p1_totalCards < 4) { //p1 loses
-        p2_score += 100;
-        displayWarWinner(p2_colour, p2_name, warNum);
-        break;
-      }
-      else if (p2_totalCards < 4) { //p2 loses
-        p1_score += 100;
-        displayWarWinner(p1_colour, p1_name, warNum);
-        break;
+#ifndef WARGAME_NO_MAIN //defined by benchmark.cpp, which includes this file to time the game's own functions
+int main(int argc, char *argv[]) {
+  if (argc > 1 && strcmp(argv[1], "--simulate") == 0) {
+    return simulateGames(argc-2, argv+2);
+  }
+  if (argc > 1 && strcmp(argv[1], "--tournament") == 0) {
+    return runTournamentMode(argc-2, argv+2);
+  }
+  if (argc > 1 && strcmp(argv[1], "--replay") == 0) {
+    return replayGames(argc-2, argv+2);
+  }
+  if (argc > 1 && strcmp(argv[1], "--analyze") == 0) {
+    return analyzeMode(argc-2, argv+2);
+  }
+  if (argc > 1 && strcmp(argv[1], "--variant") == 0) {
+    return variantMode(argc-2, argv+2);
+  }
+  if (argc > 1 && strcmp(argv[1], "--tune") == 0) {
+    return tuneMode(argc-2, argv+2);
+  }
+  if (argc > 1 && strcmp(argv[1], "--serve") == 0) {
+    return serveMode(argc-2, argv+2);
+  }
+  //Display options for the interactive game
+  GameFlow flow(time(0), STDOUT_FILENO); //seeded once (rather than before every shuffle) so shuffles in the same second still differ
+  RecordWriter gameLog; //with --record every war is appended here
+  for (int i=1; i<argc; i++) {
+    if (strcmp(argv[i], "--no-color") == 0) {
+      flow.screen.setMode(Renderer::PLAIN);
+    }
+    else if (strcmp(argv[i], "--quiet") == 0) {
+      quietMode = true;
+    }
+    else if (strcmp(argv[i], "--odds") == 0) {
+      showOdds = true;
+    }
+    else if (strcmp(argv[i], "--record") == 0 && i+1 < argc) {
+      i++;
+      if (!gameLog.open(argv[i])) {
+        cout << "Cannot open record file: " << argv[i] << endl;
+        return 1;
       }
-      pressEnter("BEGIN THE NEXT BATTLE"); //only executes if the war has not ended yet (i.e. loop has not been broken out of)
-    }    
-    cout << endl;
-    playAgain = getAgainChoice();
-    cout << endl;
+      flow.game.recordWriter = &gameLog;
+    }
+    else {
+      cout << "Usage: wargame [--no-color] [--quiet] [--odds] [--record <file>]" << endl;
+      cout << "       wargame --simulate <games> <seed> [P1 policy] [P2 policy] [--record <file>]" << endl;
+      cout << "       wargame --tournament <games per pairing> <seed> [threads] [policy ...]" << endl;
+      cout << "       wargame --replay <file> [game number]" << endl;
+      cout << "       wargame --analyze <P1 policy> <P2 policy> <P1 deck> <P1 discard> <P2 deck> <P2 discard> [--horizon N] [--samples N] [--cache-mb N] [--max-branches N] [--max-positions N]" << endl;
+      cout << "       wargame --variant <variant> <games> <seed> [policy for each seat ...]" << endl;
+      cout << "       wargame --tune <generations> <deals per candidate> <seed> <opponent policy ...> [--population N] [--elite N] [--threads N] [--checkpoint <file>] [--validate <deals>] [--reference <policy>]" << endl;
+      cout << "       wargame --serve <socket path> [seed] [--no-color] [--quiet] [--record <file>]" << endl;
+      return 1;
+    }
+  }
+  //The game only moves on when a line of input arrives (see GameFlow); at the end of the input the game is abandoned
+  flow.start();
+  string line;
+  while (!flow.finished() && getline(cin, line)) {
+    flow.input(line);
+  }
+  if (flow.game.recordWriter != nullptr && !gameLog.close()) {
+    cout << "Cannot write record file: " << strerror(gameLog.error()) << " (the wars not yet written are lost)" << endl;
+    return 1;
+  }
+  if (INSTRUMENT_ENABLED) {
+    cout << "\n" << instrumentSummary() << flush;
   }
-  while (playAgain);
-  //If the above loop has been exited, the game is over
-  gameConclusion();
   return 0;
 }
+#endif
@@ -0,0 +1,125 @@
+#ifndef WARGAME_WORKPOOL_H
+#define WARGAME_WORKPOOL_H
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*WORK-STEALING TASK RUNNER
+Runs tasks 0..numTasks-1 on a set of worker threads. Each worker starts with its own contiguous block of task numbers and takes them from the front; a worker that runs out steals the back half of the largest remaining block, so a few long tasks (e.g. long games) do not leave the other cores idle.
+Tasks should be coarse (thousands of games each): every take is a short lock on the owning worker's block.
+*/
+
+/*defaultThreadCount
+Purpose: choosing how many worker threads to use when the user does not say
+Return: number of hardware threads (at least 1)
+*/
+inline int defaultThreadCount() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+class WorkStealingPool {
+public:
+  /*WorkStealingPool constructor
+  Parameters: number of worker threads
+  */
+  explicit WorkStealingPool(int numThreads) : queues(std::max(1, numThreads)) {}
+
+  int threadCount() const { return queues.size(); }
+
+  /*run
+  Purpose: running every task once and waiting for all of them to finish
+  Parameters: number of tasks, function called as task(taskNumber, workerNumber) (workerNumber is in [0, threadCount()) and can index per-worker results, which need no locking)
+  */
+  template <typename Task>
+  void run(long long numTasks, Task task) {
+    int numThreads = queues.size();
+    //Split the task numbers into one contiguous block per worker
+    for (int w=0; w<numThreads; w++) {
+      queues[w].begin = numTasks * w / numThreads;
+      queues[w].end = numTasks * (w+1) / numThreads;
+    }
+    std::vector<std::thread> threads;
+    for (int w=1; w<numThreads; w++) {
+      threads.emplace_back([this, w, &task]() { work(w, task); });
+    }
+    work(0, task); //the calling thread is worker 0
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+  }
+
+private:
+  //One worker's remaining tasks, [begin, end)
+  struct alignas(64) TaskBlock {
+    std::mutex lock;
+    long long begin = 0, end = 0;
+  };
+
+  /*takeOwn
+  Purpose: taking the next task from a worker's own block
+  Return: task number, or -1 if the block is empty
+  */
+  long long takeOwn(int w) {
+    std::lock_guard<std::mutex> guard(queues[w].lock);
+    if (queues[w].begin == queues[w].end) {
+      return -1;
+    }
+    return queues[w].begin++;
+  }
+
+  /*steal
+  Purpose: moving the back half of the largest other block to worker w
+  Return: true if any tasks were stolen, false if every block is empty
+  */
+  bool steal(int w) {
+    while (true) {
+      int victim = -1;
+      long long victimSize = 0;
+      for (int v=0; v<(int)queues.size(); v++) {
+        std::lock_guard<std::mutex> guard(queues[v].lock);
+        if (v != w && queues[v].end - queues[v].begin > victimSize) {
+          victim = v;
+          victimSize = queues[v].end - queues[v].begin;
+        }
+      }
+      if (victim == -1) {
+        return false;
+      }
+      long long stolenBegin, stolenEnd;
+      {
+        std::lock_guard<std::mutex> guard(queues[victim].lock);
+        long long remaining = queues[victim].end - queues[victim].begin;
+        if (remaining == 0) {
+          continue; //the victim finished its block in the meantime; look again
+        }
+        stolenEnd = queues[victim].end;
+        stolenBegin = stolenEnd - (remaining + 1) / 2;
+        queues[victim].end = stolenBegin;
+      }
+      std::lock_guard<std::mutex> guard(queues[w].lock);
+      queues[w].begin = stolenBegin;
+      queues[w].end = stolenEnd;
+      return true;
+    }
+  }
+
+  template <typename Task>
+  void work(int w, Task &task) {
+    while (true) {
+      long long taskNumber = takeOwn(w);
+      if (taskNumber == -1) {
+        if (!steal(w)) {
+          return; //tasks are never added while running, so once every block is empty the worker is done
+        }
+        continue;
+      }
+      task(taskNumber, w);
+    }
+  }
+
+  std::vector<TaskBlock> queues;
+};
+
+#endif